@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+import argparse
+import socket
+import struct
+from pathlib import Path
+
+# see test_elf/source/main.cpp for the other end
+
+DUMP_PORT = 9030
+DUMP_MAGIC = 0x313030504d55444b
+DUMP_LZ4 = 1
+DUMP_HEAP = 2
+
+DUMP_HEADER = struct.Struct('<QQQII')
+CHUNK_HEADER = struct.Struct('<QII')
+HEAP_HEADER = struct.Struct('<QIi')
+PAGE_REQUEST = struct.Struct('<QII')
+
+# the .heap file next to the image: a header and then (addr, length, data) records
+HEAP_MAGIC = 0x313030504145484b
+HEAP_FILE_HEADER = struct.Struct('<QQIi')
+HEAP_RECORD = struct.Struct('<QQ')
+
+# the 3.00 struct offsets, see include/kernel/layout.hpp
+PROC_FD = 0x48
+PROC_PID = 0xbc
+FILEDESC_RDIR = 0x10
+MAX_PROCS = 0x1000
+
+PAGE_ZERO = 0
+PAGE_REPEAT = 1
+PAGE_RAW = 2
+PAGE_LZ4 = 3
+
+
+def lz4_decompress(src: bytes, size: int) -> bytes:
+    try:
+        import lz4.block
+        return lz4.block.decompress(src, uncompressed_size=size)
+    except ImportError:
+        pass
+
+    dst = bytearray()
+    i = 0
+    while i < len(src):
+        token = src[i]
+        i += 1
+        length = token >> 4
+        if length == 15:
+            while True:
+                b = src[i]
+                i += 1
+                length += b
+                if b != 255:
+                    break
+        dst += src[i:i + length]
+        i += length
+        if i >= len(src):
+            break
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        length = token & 15
+        if length == 15:
+            while True:
+                b = src[i]
+                i += 1
+                length += b
+                if b != 255:
+                    break
+        length += 4
+        start = len(dst) - offset
+        # the match may overlap the bytes it produces
+        for k in range(length):
+            dst.append(dst[start + k])
+    if len(dst) != size:
+        raise ValueError(f'decompressed {len(dst)} bytes, expected {size}')
+    return bytes(dst)
+
+
+class Stream:
+
+    def __init__(self, sock: socket.socket):
+        self.sock = sock
+        self.received = 0
+
+    def read(self, length: int) -> bytes:
+        buf = bytearray()
+        while len(buf) < length:
+            data = self.sock.recv(length - len(buf))
+            if not data:
+                raise EOFError('connection closed during the dump')
+            buf += data
+        self.received += length
+        return bytes(buf)
+
+
+def unpack_pages(payload: bytes, pages: int, page_size: int, previous: bytes, offset: int):
+    page_map = payload[:pages]
+    pos = pages
+    for i, kind in enumerate(page_map):
+        if kind == PAGE_ZERO:
+            page = bytes(page_size)
+        elif kind == PAGE_REPEAT:
+            page = previous
+        elif kind == PAGE_RAW:
+            page = payload[pos:pos + page_size]
+            pos += page_size
+        elif kind == PAGE_LZ4:
+            (compressed, ) = struct.unpack_from('<I', payload, pos)
+            pos += 4
+            page = lz4_decompress(payload[pos:pos + compressed], page_size)
+            pos += compressed
+        else:
+            raise ValueError(f'unknown page type {kind} at {offset + i * page_size:#x}')
+        yield kind, page
+        previous = page
+
+
+class HeapPages:
+    """Fetches pages of the direct map from the payload, each page is only requested once"""
+
+    def __init__(self, stream: Stream, page_size: int):
+        self.stream = stream
+        self.page_size = page_size
+        self.pages = {}
+
+    def read(self, addr: int, length: int):
+        first = addr & ~(self.page_size - 1)
+        last = (addr + length - 1) & ~(self.page_size - 1)
+        missing = [p for p in range(first, last + self.page_size, self.page_size) if p not in self.pages]
+        if missing:
+            count = (missing[-1] - missing[0]) // self.page_size + 1
+            self.stream.sock.sendall(PAGE_REQUEST.pack(missing[0], count, 0))
+            start, pages, payload_length = CHUNK_HEADER.unpack(self.stream.read(CHUNK_HEADER.size))
+            if pages == 0:
+                for i in range(count):
+                    self.pages[missing[0] + i * self.page_size] = None
+            else:
+                payload = self.stream.read(payload_length)
+                previous = bytes(self.page_size)
+                for i, (_, page) in enumerate(unpack_pages(payload, pages, self.page_size, previous, start)):
+                    self.pages[start + i * self.page_size] = page
+                    previous = page
+        data = b''.join(self.pages[p] or b'' for p in range(first, last + self.page_size, self.page_size))
+        if len(data) != last + self.page_size - first:
+            return None
+        return data[addr - first:addr - first + length]
+
+    def finish(self):
+        self.stream.sock.sendall(PAGE_REQUEST.pack(0, 0, 0))
+
+    def runs(self):
+        """Yields the fetched pages merged into (addr, data) runs"""
+        run_start = None
+        run = bytearray()
+        for addr in sorted(p for p, page in self.pages.items() if page is not None):
+            if run_start is not None and addr != run_start + len(run):
+                yield run_start, bytes(run)
+                run_start = None
+                run = bytearray()
+            if run_start is None:
+                run_start = addr
+            run += self.pages[addr]
+        if run_start is not None:
+            yield run_start, bytes(run)
+
+
+def dump_heap(stream: Stream, image: Path, page_size: int, allproc: int):
+    """Fetches the pages discovery follows out of the data segment, the procs and their filedescs"""
+    pipe_addr, version, pid = HEAP_HEADER.unpack(stream.read(HEAP_HEADER.size))
+    print(f'pipe: {pipe_addr:#x} version: {version:#x} pid: {pid}')
+
+    heap = HeapPages(stream, page_size)
+    with open(image, 'rb') as fp:
+        fp.seek(allproc)
+        (proc, ) = struct.unpack('<Q', fp.read(8))
+    procs = 0
+    while proc != 0 and procs < MAX_PROCS:
+        buf = heap.read(proc, PROC_PID + 4)
+        if buf is None:
+            print(f'proc {proc:#x} is outside of the readable direct map')
+            break
+        (fd, ) = struct.unpack_from('<Q', buf, PROC_FD)
+        if fd != 0 and heap.read(fd + FILEDESC_RDIR, 8) is None:
+            print(f'filedesc {fd:#x} is outside of the readable direct map')
+        (proc, ) = struct.unpack_from('<Q', buf, 0)
+        procs += 1
+    heap.finish()
+
+    path = image.with_suffix(image.suffix + '.heap')
+    total = 0
+    with open(path, 'wb') as fp:
+        fp.write(HEAP_FILE_HEADER.pack(HEAP_MAGIC, pipe_addr, version, pid))
+        for addr, data in heap.runs():
+            fp.write(HEAP_RECORD.pack(addr, len(data)))
+            fp.write(data)
+            total += len(data)
+    print(f'{procs} procs, {total:#x} bytes of the direct map written to {path}')
+
+
+def reassemble(stream: Stream, out: Path):
+    magic, base, size, page_size, flags = DUMP_HEADER.unpack(stream.read(DUMP_HEADER.size))
+    if magic != DUMP_MAGIC:
+        raise ValueError(f'bad dump magic {magic:#x}')
+    print(f'kernel_base: {base:#x} size: {size:#x} lz4: {bool(flags & DUMP_LZ4)}')
+
+    counts = [0, 0, 0, 0]
+    previous = bytes(page_size)
+    with open(out, 'wb') as fp:
+        # zero pages are left as holes
+        fp.truncate(size)
+        while True:
+            offset, pages, length = CHUNK_HEADER.unpack(stream.read(CHUNK_HEADER.size))
+            if pages == 0:
+                break
+            payload = stream.read(length)
+            for i, (kind, page) in enumerate(unpack_pages(payload, pages, page_size, previous, offset)):
+                counts[kind] += 1
+                if kind != PAGE_ZERO:
+                    fp.seek(offset + i * page_size)
+                    fp.write(page)
+                previous = page
+
+    total = sum(counts)
+    print(f'{total} pages: {counts[PAGE_ZERO]} zero, {counts[PAGE_REPEAT]} repeated, '
+          f'{counts[PAGE_RAW]} raw, {counts[PAGE_LZ4]} lz4')
+    print(f'received {stream.received:#x} bytes for {size:#x}')
+    # kept next to the image so that offline tools know where it was mapped
+    out.with_suffix(out.suffix + '.base').write_text(f'{base:#x}\n')
+    return page_size
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Receives a kernel data dump from test_elf and rebuilds the flat image')
+    parser.add_argument('ip', help='PS5 ip address')
+    parser.add_argument('--out', default='kernel_data.bin', help='Path to write the image to. (default: kernel_data.bin)')
+    parser.add_argument('--lz4', default=False, action='store_true', help='Compress the pages which are not elided. (default: False)')
+    parser.add_argument('--allproc', type=lambda v: int(v, 0), default=None,
+                        help='Offset of allproc in the data segment. When given, the proc list is also dumped for offline discovery. '
+                             'It must already be known, so test_elf/host/discover_dump can only re-check known firmwares.')
+    args = parser.parse_args()
+
+    flags = (DUMP_LZ4 if args.lz4 else 0) | (DUMP_HEAP if args.allproc is not None else 0)
+    out = Path(args.out)
+    with socket.create_connection((args.ip, DUMP_PORT)) as sock:
+        sock.sendall(struct.pack('<I', flags))
+        stream = Stream(sock)
+        page_size = reassemble(stream, out)
+        if args.allproc is not None:
+            dump_heap(stream, out, page_size, args.allproc)
+
+
+if __name__ == '__main__':
+    main()
@@ -11,6 +11,20 @@ extern "C" {
 
 namespace dbg {
 
+/**
+ * Holds the debugger authid for the lifetime of the object.
+ * The proc and ucred are only resolved when the outermost session is created,
+ * any mdbg calls made while a session is alive skip the authid swap entirely.
+ * Sessions may be nested and calls made outside of a session still work.
+ */
+class Session {
+	public:
+		Session();
+		~Session();
+		Session(const Session&) = delete;
+		Session &operator=(const Session&) = delete;
+};
+
 class IdArray {
 	int *ptr;
 	size_t size;
@@ -163,6 +177,137 @@ inline UniquePtr<uint8_t[]> read(int pid, uintptr_t addr, size_t length) {
 	return buf;
 }
 
+struct ReadOp {
+	uintptr_t src;
+	void *dst;
+	size_t length;
+};
+
+/**
+ * Reads multiple scattered ranges from a process.
+ * Adjacent and overlapping ranges are fused so the minimal number of reads are performed.
+ * The destination of a failed op is zero filled.
+ * @param pid the process id
+ * @param ops the ranges to read
+ * @param n the number of ops
+ * @param errors optional array of length n which receives 0 or the error for each op
+ * @return the number of ops which failed
+ */
+size_t readv(int pid, const ReadOp *ops, size_t n, int *errors=nullptr);
+
+// the granularity at which readRange skips unmapped memory
+static constexpr size_t RANGE_PAGE_SIZE = 0x4000;
+
+// the size of each transfer made by readRange, large enough to amortize the mdbg call
+static constexpr size_t RANGE_CHUNK_SIZE = 0x100000;
+
+// one bit per page of a range read by readRange, set when the page was readable
+// page 0 is the page containing the start of the range
+class PageBitmap {
+
+	Array<uint64_t> bits;
+	size_t pages;
+
+	public:
+		PageBitmap(size_t pages) : bits((pages + 63) / 64), pages(pages) {
+			__builtin_memset(bits.data(), 0, bits.length() * sizeof(uint64_t));
+		}
+
+		void set(size_t page) {
+			bits[page >> 6] |= 1ULL << (page & 63);
+		}
+
+		bool test(size_t page) const {
+			return bits[page >> 6] & (1ULL << (page & 63));
+		}
+
+		void clear() {
+			__builtin_memset(bits.data(), 0, bits.length() * sizeof(uint64_t));
+		}
+
+		size_t length() const {
+			return pages;
+		}
+
+		/**
+		 * @return the number of readable pages
+		 */
+		size_t count() const {
+			size_t n = 0;
+			for (const uint64_t word : bits) {
+				n += __builtin_popcountll(word);
+			}
+			return n;
+		}
+
+		bool all() const {
+			return count() == pages;
+		}
+};
+
+/**
+ * Reads part of a range, bisecting failed reads down to single pages
+ * The pages which could not be read are zero filled and left unset in the bitmap
+ * @param pid the process id
+ * @param base the page aligned start of the whole range
+ * @param addr the address to read from
+ * @param dst the destination buffer
+ * @param length the number of bytes to read which must not leave the range
+ * @param valid the bitmap of the whole range
+ */
+void readPages(int pid, uintptr_t base, uintptr_t addr, uint8_t *dst, size_t length, PageBitmap &valid);
+
+/**
+ * Reads a large range which may contain unmapped holes.
+ * The range is transferred RANGE_CHUNK_SIZE bytes at a time so memory use does not depend on length.
+ * The sink is invoked as sink(addr, data, length) with every readable span of a chunk in
+ * ascending order, the data is only valid for the duration of the call.
+ * Spans are split at chunk boundaries.
+ * @param pid the process id
+ * @param addr the start of the range
+ * @param length the length of the range
+ * @param sink the callback receiving the readable memory
+ * @return the bitmap of the pages which were readable
+ */
+template <typename Sink>
+PageBitmap readRange(int pid, uintptr_t addr, size_t length, Sink &&sink) {
+	const uintptr_t base = addr & ~(RANGE_PAGE_SIZE - 1);
+	const uintptr_t end = addr + length;
+	PageBitmap valid{(end - base + RANGE_PAGE_SIZE - 1) / RANGE_PAGE_SIZE};
+	if (length == 0) [[unlikely]] {
+		return valid;
+	}
+
+	UniquePtr<uint8_t[]> buf{new uint8_t[RANGE_CHUNK_SIZE]};
+	Session session{};
+	uintptr_t pos = addr;
+	while (pos < end) {
+		// every chunk after the first starts on a page boundary
+		const uintptr_t chunkEnd = (pos & ~(RANGE_PAGE_SIZE - 1)) + RANGE_CHUNK_SIZE;
+		const size_t n = (chunkEnd < end ? chunkEnd : end) - pos;
+		readPages(pid, base, pos, buf.get(), n, valid);
+
+		size_t i = 0;
+		while (i < n) {
+			const uintptr_t page = (pos + i - base) / RANGE_PAGE_SIZE;
+			const size_t inPage = RANGE_PAGE_SIZE - ((pos + i) & (RANGE_PAGE_SIZE - 1));
+			const size_t step = inPage < n - i ? inPage : n - i;
+			if (!valid.test(page)) {
+				i += step;
+				continue;
+			}
+			const size_t start = i;
+			i += step;
+			while (i < n && valid.test((pos + i - base) / RANGE_PAGE_SIZE)) {
+				i += RANGE_PAGE_SIZE < n - i ? RANGE_PAGE_SIZE : n - i;
+			}
+			sink(pos + start, static_cast<const uint8_t *>(buf.get() + start), i - start);
+		}
+		pos += n;
+	}
+	return valid;
+}
+
 bool write(int pid, uintptr_t dst, const void *src, size_t length);
 
 class ProcessInfoIterator {
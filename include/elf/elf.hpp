@@ -29,19 +29,55 @@ class Elf : Elf64_Ehdr {
 	uintptr_t imagebase;
 	UniquePtr<uint8_t[]> data;
 	Array<SymbolLookupTable> libs;
+	Array<uintptr_t> imports; // addresses resolved in the target indexed by symbol
+	size_t numImports;
+	bool resolveInTarget;
+	bool verifyImports;
+	Array<uint8_t *> segments; // local addresses of the segments shared with the process
+	uint8_t *sharedText;
+	size_t sharedTextLength;
+	uint8_t *sharedData;
+	size_t sharedDataLength;
 
 	bool processProgramHeaders();
 	bool parseDynamicTable();
+	bool resolveImports();
+	bool resolveImportsInTarget();
+	void fillSymbolTables();
+	void compareImports();
 	bool processRelocations();
 	bool processPltRelocations();
 	bool load();
 	bool start(uintptr_t args);
+	bool startThread(uintptr_t args);
 	uintptr_t setupKernelRW();
+	int shareData();
 	uintptr_t getSymbolAddress(const Elf64_Rela *__restrict rel) const;
+	uintptr_t findLibrarySymbol(const char *name) const;
 
 	public:
 		Elf(Hijacker *hijacker, uint8_t *data);
 		~Elf();
 
 		bool launch();
+
+		/**
+		 * Sets whether imports are resolved with sceKernelDlsym in the target
+		 * instead of copying the symbol tables of every library.
+		 * The symbol tables are still used if resolving in the target fails.
+		 * @param enable true to resolve in the target
+		 */
+		void setResolveInTarget(bool enable) {
+			resolveInTarget = enable;
+		}
+
+		/**
+		 * Sets whether imports resolved in the target are checked against the symbol tables.
+		 * This fills every symbol table so it defeats the purpose of resolving in the target,
+		 * it is only meant for timing and testing both.
+		 * @param enable true to compare
+		 */
+		void setVerifyImports(bool enable) {
+			verifyImports = enable;
+		}
 };
@@ -10,3 +10,12 @@ class ScopedSuspender {
 		ScopedSuspender(Hijacker *hijacker) : hijacker(hijacker) { hijacker->suspend(); }
 		~ScopedSuspender() { hijacker->resume(); }
 };
+
+class ScopedScratch {
+	Hijacker *hijacker;
+	ScratchMark mark;
+
+	public:
+		ScopedScratch(Hijacker *hijacker) : hijacker(hijacker), mark(hijacker->markScratch()) {}
+		~ScopedScratch() { hijacker->releaseScratch(mark); }
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+}
+
+#include "call.hpp"
+#include "util.hpp"
+
+class Hijacker;
+class TrapFrame;
+
+// the layout is shared with shellcode/agent.cpp
+struct AgentCommand {
+	enum Op : uint32_t {
+		CALL,
+		COPY,
+		START
+	};
+
+	uint32_t op;
+	int32_t err;
+	int64_t result;
+	uintptr_t fn;
+	uint64_t args[RemoteCall::MAX_ARGS];
+};
+
+struct AgentQueue {
+	static constexpr uint32_t NUM_SLOTS = 32;
+
+	uint32_t head;
+	uint32_t tail;
+	uint32_t started; // set by the agent once the main thread enters it
+	uint32_t reserved;
+	uintptr_t usleep;
+	uintptr_t error;
+	AgentCommand commands[NUM_SLOTS];
+};
+
+// a loop resident on the target's main thread which services commands from the mailbox
+// the results of a command are only valid until NUM_SLOTS more commands have been submitted
+class Agent {
+	Hijacker *hijacker;
+	AgentQueue *queue;
+	UniquePtr<TrapFrame> backup;
+	uint32_t head;
+	bool running;
+
+	Agent(Hijacker *hijacker, AgentQueue *queue, TrapFrame *backup);
+
+	AgentCommand &next();
+	uint32_t submit();
+
+	public:
+		/**
+		 * Injects the agent into the target's main thread and waits for the thread to enter it
+		 * The thread is returned to where it was if it doesn't get there in time.
+		 * @param hijacker the hijacker for the target process
+		 * @return the agent or nullptr if the mailbox is unavailable or the agent never started
+		 */
+		static UniquePtr<Agent> create(Hijacker &hijacker);
+
+		Agent(const Agent&) = delete;
+		Agent &operator=(const Agent&) = delete;
+
+		/**
+		 * Returns the main thread to where it was interrupted if the agent is still running
+		 */
+		~Agent();
+
+		/**
+		 * Queues a call to a function in the target process
+		 * @param fn the address of the function
+		 * @param args the integer or pointer arguments
+		 * @return the ticket for the command
+		 */
+		template <typename... Args>
+		uint32_t call(uintptr_t fn, Args... args) {
+			static_assert(sizeof...(Args) <= RemoteCall::MAX_ARGS, "too many arguments");
+			AgentCommand &cmd = next();
+			cmd = {AgentCommand::CALL, 0, 0, fn, {toCallArgument(args)...}};
+			return submit();
+		}
+
+		/**
+		 * Queues a call prepared for a CallBatch
+		 * @param call the call
+		 * @return the ticket for the command
+		 */
+		uint32_t call(const RemoteCall &call);
+
+		/**
+		 * Queues a copy within the target process
+		 * @param dst the destination address
+		 * @param src the source address
+		 * @param length the number of bytes to copy
+		 * @return the ticket for the command
+		 */
+		uint32_t copy(uintptr_t dst, uintptr_t src, size_t length);
+
+		/**
+		 * Queues a jump to the entry point of a payload.
+		 * The agent stops running once the command is reached.
+		 * @param entry the entry point
+		 * @param rsp the stack pointer for the payload
+		 * @param arg the argument for the payload
+		 */
+		void start(uintptr_t entry, uintptr_t rsp, uintptr_t arg);
+
+		/**
+		 * Waits for a command to complete
+		 * The agent is abandoned and the thread returned if the command takes too long.
+		 * @param ticket the ticket for the command
+		 * @return false if the process died or the command timed out
+		 */
+		bool wait(uint32_t ticket);
+
+		/**
+		 * Waits for all the submitted commands to complete
+		 * @return false if the process died or a command timed out
+		 */
+		bool flush() {
+			return head == 0 || wait(head - 1);
+		}
+
+		template <typename R=int64_t>
+		R result(uint32_t ticket) const {
+			return (R) queue->commands[ticket % AgentQueue::NUM_SLOTS].result;
+		}
+
+		int error(uint32_t ticket) const {
+			return queue->commands[ticket % AgentQueue::NUM_SLOTS].err;
+		}
+
+		bool isRunning() const {
+			return running;
+		}
+};
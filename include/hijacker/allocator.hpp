@@ -7,6 +7,8 @@ class ProcessMemoryAllocator {
 	size_t allocated;
 
 	public:
+		static constexpr size_t MAX_ALLOCATED = 0x4000;
+
 		ProcessMemoryAllocator(decltype(nullptr)) : section(nullptr), allocated() {}
 		ProcessMemoryAllocator(const SharedLibSection *section) : section(section), allocated() {}
 		ProcessMemoryAllocator(const ProcessMemoryAllocator &rhs) = default;
@@ -19,16 +21,36 @@ class ProcessMemoryAllocator {
 			allocated = 0;
 		}
 
+		size_t getAllocated() const {
+			return allocated;
+		}
+
+		/**
+		 * Marks memory already in use by an earlier allocator as allocated
+		 * @param size the number of bytes in use from the end of the section
+		 */
+		void setAllocated(size_t size) {
+			allocated = size;
+		}
+
 		/**
 		 * Allocated virtual memory from the end of the existing section.
 		 * It is allocated from the end because this portion of memory is likely unused.
+		 * Only the last MAX_ALLOCATED bytes may be used so that live code or data is not overwritten.
 		 * @param size the size of memory to "allocate"
-		 * @return the virtual address for the requested memory
+		 * @return the virtual address for the requested memory or 0 if the limit was reached
 		 */
 		uintptr_t allocate(size_t size) {
 			if ((size & 0xf) != 0) {
 				size = (size & ~0xf) + 0x10;
 			}
+			const size_t length = section->sectionLength();
+			const size_t limit = length < MAX_ALLOCATED ? length : MAX_ALLOCATED;
+			if (allocated + size > limit) [[unlikely]] {
+				// a long lived spawner must survive this, the callers check for 0
+				__builtin_printf("ProcessMemoryAllocator exhausted allocating 0x%llx bytes\n", (unsigned long long) size);
+				return 0;
+			}
 			allocated += size;
 			return section->end() - allocated;
 		}
@@ -0,0 +1,81 @@
+#pragma once
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+}
+
+class Hijacker;
+
+// the layout is shared with shellcode/trampoline.cpp
+struct RemoteCall {
+	static constexpr size_t MAX_ARGS = 12;
+
+	uintptr_t fn;
+	uint64_t args[MAX_ARGS];
+	int64_t result;
+	int32_t err;
+};
+
+template <typename T>
+static constexpr uint64_t toCallArgument(T value) {
+	static_assert(sizeof(T) <= sizeof(uint64_t), "arguments must fit in a register");
+	return (uint64_t) value;
+}
+
+// calls which are executed together in a single hijack of the target's main thread
+class CallBatch {
+	static constexpr size_t MAX_CALLS = 32;
+
+	Hijacker *hijacker;
+	RemoteCall calls[MAX_CALLS];
+	size_t count;
+
+	public:
+		CallBatch(Hijacker *hijacker) : hijacker(hijacker), calls(), count() {}
+
+		/**
+		 * Queues a call to a function in the target process
+		 * @param fn the address of the function
+		 * @param args the integer or pointer arguments
+		 * @return the index of the call or -1 if the batch is full
+		 */
+		template <typename... Args>
+		int add(uintptr_t fn, Args... args) {
+			static_assert(sizeof...(Args) <= RemoteCall::MAX_ARGS, "too many arguments");
+			if (count == MAX_CALLS) [[unlikely]] {
+				return -1;
+			}
+			RemoteCall &call = calls[count];
+			call = {fn, {toCallArgument(args)...}, 0, 0};
+			return count++;
+		}
+
+		/**
+		 * Executes all the queued calls in order
+		 * @return false if the calls could not be executed
+		 */
+		bool execute();
+
+		void clear() {
+			count = 0;
+		}
+
+		size_t length() const {
+			return count;
+		}
+
+		template <typename R=int64_t>
+		R result(size_t i) const {
+			return (R) calls[i].result;
+		}
+
+		/**
+		 * Gets the errno set by the call
+		 * @param i the index of the call
+		 * @return the errno or 0 if it was not set
+		 */
+		int error(size_t i) const {
+			return calls[i].err;
+		}
+};
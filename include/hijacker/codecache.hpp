@@ -0,0 +1,63 @@
+#pragma once
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+}
+
+class Hijacker;
+
+// the registry lives at the very end of the eboot's text section in the target
+// so that every hijacker attached to the process finds the same copies
+struct CodeCacheRegistry {
+	static constexpr uint64_t MAGIC = 0x454843414352484a; // JHRCACHE
+	static constexpr uint32_t MAX_ENTRIES = 16;
+
+	struct Entry {
+		uint64_t hash;
+		uint32_t offset; // distance from the end of the section
+		uint32_t length;
+	};
+
+	uint64_t magic;
+	uint32_t count;
+	uint32_t used; // bytes of the section in use including the registry
+	Entry entries[MAX_ENTRIES];
+};
+
+// uploads code into the target only if an identical copy isn't already resident
+class CodeCache {
+	Hijacker *hijacker;
+	uintptr_t address;
+	CodeCacheRegistry registry;
+	bool loaded;
+
+	bool load();
+
+	public:
+		CodeCache(Hijacker *hijacker) : hijacker(hijacker), address(), registry(), loaded() {}
+		CodeCache(const CodeCache&) = delete;
+		CodeCache &operator=(const CodeCache&) = delete;
+
+		/**
+		 * Gets the address of a copy of the code in the target, uploading it if necessary
+		 * @param code the code
+		 * @param length the length of the code
+		 * @return the address of the code or 0 if there is no space for it
+		 */
+		uintptr_t get(const uint8_t *code, size_t length);
+
+		/**
+		 * Computes the FNV-1a hash of a code blob
+		 * @param code the code
+		 * @param length the length of the code
+		 * @return the hash
+		 */
+		static constexpr uint64_t hash(const uint8_t *code, size_t length) {
+			uint64_t h = 0xcbf29ce484222325;
+			for (size_t i = 0; i < length; i++) {
+				h = (h ^ code[i]) * 0x100000001b3;
+			}
+			return h;
+		}
+};
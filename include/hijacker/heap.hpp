@@ -0,0 +1,127 @@
+#pragma once
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+}
+
+class RemoteHeap;
+
+// owns memory allocated from a RemoteHeap and frees it when destroyed
+class RemoteAllocation {
+	RemoteHeap *heap;
+	uintptr_t addr;
+
+	public:
+		RemoteAllocation() : heap(nullptr), addr() {}
+		RemoteAllocation(RemoteHeap *heap, uintptr_t addr) : heap(heap), addr(addr) {}
+		RemoteAllocation(const RemoteAllocation&) = delete;
+		RemoteAllocation &operator=(const RemoteAllocation&) = delete;
+		RemoteAllocation(RemoteAllocation &&rhs) : heap(rhs.heap), addr(rhs.addr) {
+			rhs.heap = nullptr;
+			rhs.addr = 0;
+		}
+		RemoteAllocation &operator=(RemoteAllocation &&rhs);
+		~RemoteAllocation();
+
+		uintptr_t address() const {
+			return addr;
+		}
+
+		/**
+		 * Gives up ownership so that the memory is never freed
+		 * @return the address of the memory
+		 */
+		uintptr_t release() {
+			heap = nullptr;
+			return addr;
+		}
+
+		explicit operator bool() const {
+			return addr != 0;
+		}
+};
+
+// allocates memory from a region reserved in another process
+// the bookkeeping is kept entirely in our process
+class RemoteHeap {
+	struct Block {
+		uintptr_t addr;
+		size_t size;
+		Block *prev; // address order
+		Block *next;
+		Block *prevFree;
+		Block *nextFree;
+		bool free;
+	};
+
+	static constexpr size_t ALIGNMENT = 0x10;
+	static constexpr size_t NUM_CLASSES = 24;
+
+	uintptr_t base;
+	size_t capacity;
+	size_t used;
+	Block *blocks;
+	Block *bins[NUM_CLASSES];
+
+	static size_t sizeClass(size_t size) {
+		const size_t c = 63 - __builtin_clzll(size / ALIGNMENT);
+		return c < NUM_CLASSES ? c : NUM_CLASSES - 1;
+	}
+
+	void insertFree(Block *block);
+	void removeFree(Block *block);
+	Block *find(uintptr_t addr) const;
+
+	public:
+		static constexpr size_t DEFAULT_CAPACITY = 0x10000;
+
+		RemoteHeap(uintptr_t base, size_t capacity);
+		RemoteHeap(const RemoteHeap&) = delete;
+		RemoteHeap &operator=(const RemoteHeap&) = delete;
+
+		/**
+		 * Releases the bookkeeping. The reserved region is left mapped in the process
+		 * since memory given to a payload may outlive the heap.
+		 * The Hijacker unmaps it when nothing was given to a payload.
+		 */
+		~RemoteHeap();
+
+		/**
+		 * Allocates memory in the process
+		 * @param size the size of memory to allocate
+		 * @return the address or 0 if there is not enough space
+		 */
+		uintptr_t allocate(size_t size);
+
+		/**
+		 * Allocates memory in the process which is freed when the handle is destroyed
+		 * @param size the size of memory to allocate
+		 * @return the allocation which is empty if there is not enough space
+		 */
+		RemoteAllocation allocation(size_t size) {
+			return {this, allocate(size)};
+		}
+
+		/**
+		 * Frees memory previously returned by allocate
+		 * @param addr the address of the memory
+		 */
+		void free(uintptr_t addr);
+
+		bool contains(uintptr_t addr) const {
+			return addr >= base && addr < base + capacity;
+		}
+
+		uintptr_t address() const {
+			return base;
+		}
+
+		size_t getCapacity() const {
+			return capacity;
+		}
+
+		size_t getUsed() const {
+			return used;
+		}
+};
@@ -7,26 +7,57 @@
 #include "kernel/rtld.hpp"
 #include "util.hpp"
 #include "allocator.hpp"
+#include "mailbox.hpp"
+#include "call.hpp"
+#include "agent.hpp"
+#include "heap.hpp"
+#include "codecache.hpp"
+#include "scanner.hpp"
 #include <sys/_stdint.h>
 
+struct ScratchMark {
+	size_t mailbox;
+	size_t heap;
+};
+
 class Hijacker {
 
+	static constexpr size_t MAX_SCRATCH_ALLOCATIONS = 16;
+
 	UniquePtr<SharedObject> obj;
 
 	protected:
 		friend class Spawner;
+		friend class CallBatch;
+		friend class CodeCache;
 		ProcessMemoryAllocator textAllocator;
 		ProcessMemoryAllocator dataAllocator;
 
 	private:
 		mutable UniquePtr<SharedLib> libkernel;
+		UniquePtr<Mailbox> mailbox;
+		bool mailboxFailed = false;
+		uintptr_t trampoline = 0;
+		int lastCallError = 0;
+		UniquePtr<Agent> agent;
+		bool agentFailed = false;
+		UniquePtr<RemoteHeap> heap;
+		bool heapFailed = false;
+		bool dataAllocated = false;
+		uintptr_t scratchAllocations[MAX_SCRATCH_ALLOCATIONS];
+		size_t numScratchAllocations = 0;
+		CodeCache codeCache;
 	protected:
 		uintptr_t pSavedRsp = 0;
 	private:
 		int mainThreadId = -1;
 		bool isMainThreadRunning = true;
+		// the main thread's kernel objects, revalidated on use
+		uintptr_t cachedProc = 0;
+		uintptr_t cachedThread = 0;
+		uintptr_t cachedFrame = 0;
 
-		Hijacker(SharedObject *obj) : obj(obj), textAllocator(nullptr), dataAllocator(nullptr), libkernel(nullptr) {
+		Hijacker(SharedObject *obj) : obj(obj), textAllocator(nullptr), dataAllocator(nullptr), libkernel(nullptr), mailbox(nullptr), agent(nullptr), heap(nullptr), codeCache(this) {
 			auto eboot = this->obj->getEboot();
 			while (textAllocator == nullptr) {
 				textAllocator = ProcessMemoryAllocator(eboot->getTextSection());
@@ -47,21 +78,59 @@ class Hijacker {
 		}
 
 		int getMainThreadId();
+		bool isTrapFrameCacheValid();
+		void invalidateTrapFrameCache() {
+			cachedProc = 0;
+			cachedThread = 0;
+			cachedFrame = 0;
+		}
 
 	public:
 		static UniquePtr<Hijacker> getHijacker(const StringView &processName);
 		static UniquePtr<Hijacker> getHijacker(int pid) {
 			auto p = ::getProc(pid);
+			if (p == nullptr) [[unlikely]] {
+				return nullptr;
+			}
 			auto obj = p->getSharedObject();
 
 			// obj may be a nullptr when racing process creation
 			return obj ? new Hijacker{obj.release()} : nullptr;
 		}
 
+		Hijacker(const Hijacker&) = delete;
+		Hijacker &operator=(const Hijacker&) = delete;
+
+		/**
+		 * Unmaps the heap and the mailbox from the process unless
+		 * long lived memory was allocated for a payload.
+		 */
+		~Hijacker();
+
 		UniquePtr<KProc> getProc() const {
 			return ::getProc(getPid());
 		}
 
+		/**
+		 * Reads the current mappings of this process
+		 * @return the map or nullptr if it could not be read
+		 */
+		UniquePtr<VmMap> getVmMap() const {
+			auto p = getProc();
+			return p != nullptr ? VmMap::read(*p) : nullptr;
+		}
+
+		/**
+		 * Finds an unmapped range above the eboot for use with MAP_FIXED
+		 * @param size the size of the range
+		 * @param align the alignment of the range which must be a power of two
+		 * @return the start of the range or 0 if none could be found
+		 */
+		uintptr_t findFreeRegion(size_t size, size_t align) const {
+			auto map = getVmMap();
+			return map != nullptr ? map->findFree(size, align, imagebase()) : 0;
+		}
+
 		void suspend() {
 			if (isMainThreadRunning) {
 				dbg::suspend(obj->pid);
@@ -123,14 +192,197 @@ class Hijacker {
 			return textAllocator;
 		}
 
+		/**
+		 * Gets the address of the code in this process, uploading it only if
+		 * an identical copy was not already placed there by any hijacker.
+		 * @param code the code
+		 * @return the address of the code or 0 if there is no space for it
+		 */
+		template <size_t length>
+		uintptr_t loadCode(const uint8_t(&code)[length]) {
+			return codeCache.get(code, length);
+		}
+
+		/**
+		 * Gets the mailbox shared with this process, creating it on first use.
+		 * @return the mailbox or nullptr if it could not be created
+		 */
+		Mailbox *getMailbox();
+
+		/**
+		 * Gets the agent running on this process's main thread, injecting it on first use.
+		 * Once the agent has started a payload the main thread can't be used for it again.
+		 * @return the agent or nullptr if it is unavailable
+		 */
+		Agent *getAgent();
+
+		/**
+		 * Gets the agent only if it has already been injected and is still running
+		 * @return the agent or nullptr
+		 */
+		Agent *getRunningAgent() const {
+			return agent != nullptr && agent->isRunning() ? agent.get() : nullptr;
+		}
+
+		/**
+		 * Gets the heap reserved in this process, reserving it on first use.
+		 * @return the heap or nullptr if the region could not be mapped
+		 */
+		RemoteHeap *getHeap();
+
+		/**
+		 * Allocates long lived memory such as data shared with a payload.
+		 * The heap is used when possible instead of the end of the eboot's data section.
+		 * Once called the heap and the mailbox are left mapped when this hijacker is destroyed.
+		 * @param size the size of memory to allocate
+		 * @return the virtual address for the requested memory
+		 */
+		uintptr_t allocateData(size_t size);
+
+		/**
+		 * Allocates short lived memory for shellcode arguments and results.
+		 * The mailbox is used when possible so that it may be accessed without the debugger.
+		 * @param size the size of memory to allocate
+		 * @return the virtual address for the requested memory
+		 */
+		uintptr_t allocateScratch(size_t size);
+
+		/**
+		 * Releases the scratch memory allocated after the mark
+		 * @param mark the value returned by markScratch or an empty mark to release everything
+		 */
+		void releaseScratch(ScratchMark mark={0, 0}) {
+			if (mailbox != nullptr) {
+				mailbox->rewind(mark.mailbox);
+			}
+			while (numScratchAllocations > mark.heap) {
+				heap->free(scratchAllocations[--numScratchAllocations]);
+			}
+		}
+
+		/**
+		 * Gets the current position of the scratch allocator for use with releaseScratch
+		 * @return the mark
+		 */
+		ScratchMark markScratch() const {
+			return {mailbox != nullptr ? mailbox->mark() : 0, numScratchAllocations};
+		}
+
+		/**
+		 * Calls a function in this process using its main thread.
+		 * The main thread's original frame is restored afterwards.
+		 * Use a CallBatch to make multiple calls in one hijack.
+		 * @param fn the address of the function
+		 * @param args the integer or pointer arguments
+		 * @return the value returned by the function or -1 if it could not be called
+		 */
+		template <typename R=int64_t, typename... Args>
+		R call(uintptr_t fn, Args... args) {
+			CallBatch batch{this};
+			batch.add(fn, args...);
+			if (!batch.execute()) [[unlikely]] {
+				lastCallError = -1;
+				if constexpr (!__is_same(R, void)) {
+					return (R) -1;
+				} else {
+					return;
+				}
+			}
+			lastCallError = batch.error(0);
+			if constexpr (!__is_same(R, void)) {
+				return batch.result<R>(0);
+			}
+		}
+
+		/**
+		 * Gets the errno of the last function called with call
+		 * @return the errno or -1 if the function could not be called
+		 */
+		int getLastCallError() const {
+			return lastCallError;
+		}
+
+		/**
+		 * Checks the shellcode state at the provided address without blocking for long.
+		 * @param addr the address of the state
+		 * @param maxSleeps the maximum number of times to sleep when the state is in the mailbox
+		 * @return the state
+		 */
+		int32_t pollState(uintptr_t addr, uint32_t maxSleeps);
+
+		/**
+		 * Waits for the shellcode state at the provided address to become non zero
+		 * @param addr the address of the state
+		 * @param state the final state
+		 * @return false if the process died while waiting
+		 */
+		bool waitForState(uintptr_t addr, int32_t &state);
+
+		/**
+		 * Moves one of our files into this process's descriptor table.
+		 * The process holds the reference and is responsible for closing it.
+		 * On success fd is closed, mappings of the file stay valid.
+		 * @param fd our file descriptor which is left open on failure
+		 * @return the file descriptor in this process or -1 on failure
+		 */
+		int shareFile(int fd);
+
+		/**
+		 * Maps a file open in this process into our address space.
+		 * @param fd the file descriptor in this process
+		 * @param length the length of the mapping
+		 * @param prot the protection for the mapping
+		 * @return the local mapping or nullptr on failure
+		 */
+		void *mapRemoteFile(int fd, size_t length, int prot);
+
+		bool isAlive() const {
+			return dbg::getAllPids().contains(getPid());
+		}
+
 		UniquePtr<uint8_t[]> read(uintptr_t vaddr, size_t size) {
-			return dbg::read(getPid(), vaddr, size).release();
+			UniquePtr<uint8_t[]> buf{new uint8_t[size]};
+			read(vaddr, buf.get(), size);
+			return buf;
 		}
 
 		void read(uintptr_t vaddr, void *buf, size_t size) {
+			if (mailbox != nullptr && mailbox->contains(vaddr, size)) {
+				__builtin_memcpy(buf, mailbox->toLocal(vaddr), size);
+				return;
+			}
 			dbg::read(getPid(), vaddr, buf, size);
 		}
 
+		size_t readv(const dbg::ReadOp *ops, size_t n, int *errors=nullptr);
+
+		/**
+		 * Finds a pattern in this process's memory
+		 * @param region the region to search such as one of SharedLib::getSections()
+		 * @param pattern the pattern
+		 * @param maxMatches the number of matches after which the search stops
+		 * @return the addresses of the matches in ascending order
+		 */
+		Array<uintptr_t> scan(const ScanRegion &region, const Pattern &pattern, size_t maxMatches=SIZE_MAX) const {
+			return scanProcess(getPid(), region, pattern, maxMatches);
+		}
+
+		/**
+		 * Finds the first match of a pattern in the sections of a library such as the eboot
+		 * @param lib the library
+		 * @param pattern the pattern
+		 * @return the address of the match or 0 if it was not found
+		 */
+		uintptr_t scan(const SharedLib &lib, const Pattern &pattern) const {
+			for (const SharedLibSection &section : lib.getSections()) {
+				auto matches = scan(section, pattern, 1);
+				if (matches) {
+					return matches[0];
+				}
+			}
+			return 0;
+		}
+
 		template <typename T>
 		T read(uintptr_t vaddr) {
 			T t;
@@ -140,10 +392,14 @@ class Hijacker {
 
 		template <size_t size>
 		bool write(uintptr_t vaddr, const uint8_t(&buf)[size]) {
-			return dbg::write(getPid(), vaddr, buf, size);
+			return write(vaddr, buf, size);
 		}
 
 		bool write(uintptr_t vaddr, const void *buf, size_t size) {
+			if (mailbox != nullptr && mailbox->contains(vaddr, size)) {
+				__builtin_memcpy(mailbox->toLocal(vaddr), buf, size);
+				return true;
+			}
 			return dbg::write(getPid(), vaddr, buf, size);
 		}
 
@@ -155,4 +411,12 @@ class Hijacker {
 		uintptr_t getSavedRsp() const {
 			return *getPointer<uintptr_t>(pSavedRsp);
 		}
+
+		/**
+		 * Checks if this process was spawned by a Spawner and is parked in its entrypoint
+		 * @return true if the main thread is free to start a payload
+		 */
+		bool hasSavedRsp() const {
+			return pSavedRsp != 0;
+		}
 };
@@ -0,0 +1,105 @@
+#pragma once
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+}
+
+#include "util.hpp"
+
+class Hijacker;
+
+// shared memory mapped into both our process and the target
+// shellcode arguments and results placed here can be accessed without the debugger
+class Mailbox {
+	uint8_t *local;
+	uintptr_t remote;
+	size_t used;
+	size_t limit;
+
+	Mailbox(uint8_t *local, uintptr_t remote) : local(local), remote(remote), used(), limit(LENGTH) {}
+
+	public:
+		static constexpr size_t LENGTH = 0x4000;
+		static constexpr uint32_t DEFAULT_SPINS = 0x1000;
+		static constexpr uint32_t DEFAULT_SLEEP = 10;
+
+		/**
+		 * Creates the shared mapping and maps it into the target
+		 * @param hijacker the hijacker for the target process
+		 * @return the mailbox or nullptr on failure
+		 */
+		static UniquePtr<Mailbox> create(Hijacker &hijacker);
+
+		Mailbox(const Mailbox&) = delete;
+		Mailbox &operator=(const Mailbox&) = delete;
+		~Mailbox();
+
+		/**
+		 * Allocates memory from the mailbox
+		 * @param size the size of memory to allocate
+		 * @return the address in the target process or 0 if the mailbox is full
+		 */
+		uintptr_t allocate(size_t size) {
+			if ((size & 0xf) != 0) {
+				size = (size & ~0xf) + 0x10;
+			}
+			if (used + size > limit) [[unlikely]] {
+				return 0;
+			}
+			const uintptr_t addr = remote + used;
+			used += size;
+			return addr;
+		}
+
+		/**
+		 * Permanently reserves memory from the end of the mailbox
+		 * @param size the size of memory to reserve
+		 * @return the address in the target process or 0 if the mailbox is full
+		 */
+		uintptr_t reserve(size_t size) {
+			if ((size & 0xf) != 0) {
+				size = (size & ~0xf) + 0x10;
+			}
+			if (used + size > limit) [[unlikely]] {
+				return 0;
+			}
+			limit -= size;
+			return remote + limit;
+		}
+
+		/**
+		 * Releases all the memory allocated after the mark
+		 * @param mark the value returned by mark
+		 */
+		void rewind(size_t mark) {
+			used = mark;
+		}
+
+		size_t mark() const {
+			return used;
+		}
+
+		bool contains(uintptr_t addr, size_t length) const {
+			return addr >= remote && addr + length <= remote + LENGTH;
+		}
+
+		void *toLocal(uintptr_t addr) const {
+			return local + (addr - remote);
+		}
+
+		uintptr_t address() const {
+			return remote;
+		}
+
+		/**
+		 * Waits for a value written by the target to become non zero.
+		 * Spins for the requested number of iterations before falling back to sleeping.
+		 * @param state the local address of the value
+		 * @param spins the number of iterations to spin
+		 * @param sleep the time to sleep between checks once spinning is exhausted
+		 * @param maxSleeps the maximum number of times to sleep before giving up
+		 * @return the value or 0 if it did not change in time
+		 */
+		static int32_t wait(const volatile int32_t *state, uint32_t spins=DEFAULT_SPINS, uint32_t sleep=DEFAULT_SLEEP, uint32_t maxSleeps=UINT32_MAX);
+};
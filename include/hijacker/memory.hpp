@@ -58,6 +58,92 @@ class ProcessReference<bool> {
 		}
 };
 
+/**
+ * A cached copy of an object in another process.
+ * The whole object is read once and modified fields are tracked locally,
+ * only the dirty byte ranges are written back on flush.
+ * Polling is done explicitly through refresh.
+ */
+template <typename T>
+class RemoteView {
+	static_assert(__is_trivially_copyable(T), "RemoteView requires a trivially copyable type");
+
+	uintptr_t addr;
+	int pid;
+	T value;
+	DirtyMask<sizeof(T)> dirty;
+
+	uint8_t *bytes() {
+		return reinterpret_cast<uint8_t *>(&value);
+	}
+
+	public:
+		RemoteView(int pid, uintptr_t addr) : addr(addr), pid(pid), value(), dirty() {
+			refresh();
+		}
+		RemoteView(const RemoteView&) = default;
+		RemoteView &operator=(const RemoteView&) = default;
+
+		const T &get() const { return value; }
+		const T *operator->() const { return &value; }
+		uintptr_t address() const { return addr; }
+		bool isDirty() const { return !dirty.empty(); }
+
+		template <typename F>
+		RemoteView &set(F T::*member, const F &v) {
+			uint8_t *field = reinterpret_cast<uint8_t *>(&(value.*member));
+			__builtin_memcpy(field, &v, sizeof(F));
+			dirty.mark(field - bytes(), sizeof(F));
+			return *this;
+		}
+
+		RemoteView &set(const T &v) {
+			value = v;
+			dirty.markAll();
+			return *this;
+		}
+
+		/**
+		 * Re-reads the object from the process.
+		 * Fields with pending modifications keep their local value.
+		 * @return true if the read succeeded
+		 */
+		bool refresh() {
+			if (dirty.empty()) [[likely]] {
+				const dbg::ReadOp op{addr, &value, sizeof(T)};
+				return dbg::readv(pid, &op, 1) == 0;
+			}
+			T tmp;
+			const dbg::ReadOp op{addr, &tmp, sizeof(T)};
+			if (dbg::readv(pid, &op, 1) != 0) [[unlikely]] {
+				return false;
+			}
+			const uint8_t *src = reinterpret_cast<uint8_t *>(&tmp);
+			uint8_t *dst = bytes();
+			for (size_t i = 0; i < sizeof(T); i++) {
+				if (!dirty.test(i)) {
+					dst[i] = src[i];
+				}
+			}
+			return true;
+		}
+
+		/**
+		 * Writes the dirty ranges back to the process
+		 * @return true if all the writes succeeded
+		 */
+		bool flush() {
+			bool ok = true;
+			dirty.forEachSpan([this, &ok](size_t offset, size_t length) {
+				ok &= dbg::write(pid, addr + offset, bytes() + offset, length);
+			});
+			if (ok) {
+				dirty.clear();
+			}
+			return ok;
+		}
+};
+
 template <typename T>
 class ProcessPointer {
 	uintptr_t addr;
@@ -76,5 +162,6 @@ class ProcessPointer {
 			dbg::read(pid, addr, &value, sizeof(T));
 			return value;
 		}
+		RemoteView<T> view() const { return {pid, addr}; }
 		uintptr_t address() const { return addr; }
 };
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "hijacker.hpp"
+#include "spawner.hpp"
+#include "util.hpp"
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+	#include <pthread.h>
+}
+
+// keeps spawned processes jailbroken and parked in their entrypoint loop
+// so that a payload can be launched without waiting for a spawn
+// the pool is replenished on a background thread
+class ProcessPool {
+	public:
+		static constexpr size_t MAX_PROCESSES = 4;
+
+	private:
+		static constexpr int MAX_FAILURES = 3;
+
+		Spawner *spawner;
+		StringView name;
+		Hijacker *ready[MAX_PROCESSES];
+		size_t capacity;
+		size_t count;
+		int lock;
+		bool running;
+		bool exited;
+		pthread_t thread;
+
+		static void *replenish(void *pool);
+		UniquePtr<Hijacker> prepare();
+		bool push(UniquePtr<Hijacker> &&process);
+		UniquePtr<Hijacker> pop();
+
+	public:
+		/**
+		 * @param spawner the spawner used for every process
+		 * @param name the name to give the spawned processes
+		 * @param capacity the number of processes to keep ready
+		 */
+		ProcessPool(Spawner *spawner, const StringView &name, size_t capacity) :
+			spawner(spawner), name(name), ready(), capacity(capacity < MAX_PROCESSES ? capacity : MAX_PROCESSES),
+			count(), lock(), running(), exited(true), thread() {}
+		ProcessPool(const ProcessPool&) = delete;
+		ProcessPool &operator=(const ProcessPool&) = delete;
+
+		/**
+		 * Stops replenishing. The processes which are still parked are left running.
+		 */
+		~ProcessPool();
+
+		/**
+		 * Starts filling the pool in the background
+		 * @return false if the thread could not be created
+		 */
+		bool start();
+
+		/**
+		 * Stops filling the pool and waits for the background thread to exit
+		 */
+		void stop();
+
+		/**
+		 * Takes a ready process out of the pool, waiting for one if the pool is empty
+		 * @return the process or nullptr if no more processes can be spawned
+		 */
+		UniquePtr<Hijacker> take();
+
+		/**
+		 * Kills a process taken from the pool which could not be used.
+		 * It is parked at its entrypoint and is of no use to anyone.
+		 * @param process the process to kill
+		 */
+		static void discard(const Hijacker *process);
+
+		size_t available() const {
+			return __atomic_load_n(&count, __ATOMIC_ACQUIRE);
+		}
+};
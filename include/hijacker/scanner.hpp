@@ -0,0 +1,90 @@
+#pragma once
+
+#include "kernel/rtld.hpp"
+#include "util.hpp"
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+}
+
+// a byte signature where any byte or nibble may be a wildcard
+class Pattern {
+	public:
+		static constexpr size_t MAX_LENGTH = 0x100;
+
+	private:
+		uint8_t bytes[MAX_LENGTH]; // already masked
+		uint8_t mask[MAX_LENGTH];
+		size_t size;
+		size_t first; // the first fully known byte
+		size_t rare; // the fully known byte least likely to appear in code or data
+
+		void select();
+
+	public:
+		/**
+		 * Parses a pattern written as hex bytes separated by spaces such as "48 8B 05 ?? ?? ?? ?? C3"
+		 * A ? matches any nibble and a single ? matches a whole byte.
+		 * The pattern is empty if it could not be parsed or has no fully known bytes.
+		 * @param pattern the pattern
+		 */
+		Pattern(const char *pattern);
+
+		/**
+		 * @param bytes the bytes to match
+		 * @param mask the bits of each byte which must match
+		 * @param length the length of the pattern which is at most MAX_LENGTH
+		 */
+		Pattern(const uint8_t *bytes, const uint8_t *mask, size_t length);
+
+		size_t length() const {
+			return size;
+		}
+
+		size_t firstIndex() const {
+			return first;
+		}
+
+		size_t rareIndex() const {
+			return rare;
+		}
+
+		uint8_t operator[](size_t i) const {
+			return bytes[i];
+		}
+
+		bool matches(const uint8_t *data) const {
+			for (size_t i = 0; i < size; i++) {
+				if ((data[i] & mask[i]) != bytes[i]) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		explicit operator bool() const {
+			return size != 0;
+		}
+};
+
+// a range of a process's address space to scan
+struct ScanRegion {
+	uintptr_t start;
+	size_t length;
+
+	ScanRegion(uintptr_t start, size_t length) : start(start), length(length) {}
+	ScanRegion(const SharedLibSection &section) : start(section.start()), length(section.sectionLength()) {}
+};
+
+/**
+ * Scans a region of a process for a pattern
+ * The next chunk is read on another thread while the current one is scanned.
+ * Pages which can't be read are skipped.
+ * @param pid the process id
+ * @param region the region
+ * @param pattern the pattern
+ * @param maxMatches the number of matches after which the scan stops
+ * @return the addresses of the matches in ascending order
+ */
+Array<uintptr_t> scanProcess(int pid, const ScanRegion &region, const Pattern &pattern, size_t maxMatches);
@@ -12,7 +12,6 @@ extern "C" {
 
 class Spawner {
 	dbg::IdArray pids;
-	ProcessPointer<int32_t> state;
 	UniquePtr<Hijacker> hijacker;
 	uintptr_t entry;
 	uintptr_t dlsym;
@@ -24,7 +23,10 @@ class Spawner {
 	int32_t getResult() const;
 
 	public:
-		~Spawner() { *state = false; }
+		~Spawner() {
+			const int32_t state = 0;
+			hijacker->write(argbuf, &state, sizeof(state));
+		}
 		static UniquePtr<Spawner> getSpawner(const StringView &processName) {
 			auto hijacker = Hijacker::getHijacker(processName);
 			return hijacker ? new Spawner(hijacker.release()) : nullptr;
@@ -4,3 +4,4 @@
 #include "kernel/rtld.hpp"
 #include "kernel/proc.hpp"
 #include "kernel/frame.hpp"
+#include "kernel/vmmap.hpp"
@@ -0,0 +1,340 @@
+#pragma once
+
+#include "layout.hpp"
+#include "util.hpp"
+#include <immintrin.h>
+
+extern "C" {
+	#include <stddef.h>
+	#include <stdint.h>
+	#include <string.h>
+	#include <ps5/kernel.h>
+	extern uintptr_t kernel_base;
+	extern uint64_t _pipe_addr;
+}
+
+// finds the kernel offsets of firmwares which are not in layout::LAYOUTS
+// everything is done through a reader so that it can run against a dump of kernel data
+namespace discovery {
+
+// the size of the kernel data segment which is also the size of a test_elf dump
+static constexpr size_t DATA_SIZE = 0x87BF000;
+
+static constexpr size_t NOT_FOUND = (size_t) -1;
+
+template <class R>
+concept KernelReader = requires (R reader, uintptr_t addr, void *dst, size_t length) {
+	reader.read(addr, dst, length);
+	reader.base();
+	reader.size();
+};
+
+// reads through the kernel r/w primitive
+// a bad pointer would panic the kernel so only the data segment and the part of the
+// direct map which the r/w pipe was allocated from are readable
+class LiveReader {
+
+	static constexpr unsigned int DMAP_SHIFT = 39;
+	static constexpr uintptr_t MAX_PHYSICAL = 0x800000000;
+
+	uintptr_t dmap;
+
+	public:
+		LiveReader() : dmap((_pipe_addr >> DMAP_SHIFT) << DMAP_SHIFT) {}
+
+		uintptr_t base() const {
+			return kernel_base;
+		}
+
+		size_t size() const {
+			return DATA_SIZE;
+		}
+
+		bool read(uintptr_t addr, void *dst, size_t length) const {
+			const bool data = addr >= kernel_base && addr + length <= kernel_base + DATA_SIZE;
+			const bool heap = addr >= dmap && addr + length <= dmap + MAX_PHYSICAL;
+			if ((!data && !heap) || addr + length < addr) [[unlikely]] {
+				return false;
+			}
+			kernel_copyout(addr, dst, length);
+			return true;
+		}
+};
+
+// reads from memory captured by a dump, the data segment and optionally the pages of the
+// direct map which discovery follows out of it such as the proc list
+class DumpReader {
+
+	public:
+		struct Region {
+			uintptr_t addr;
+			const uint8_t *data;
+			size_t length;
+		};
+
+	private:
+		Region data;
+		const Region *extra;
+		size_t numExtra;
+
+	public:
+		/**
+		 * @param base the kernel_base the data segment was dumped from
+		 * @param data the dumped data segment
+		 * @param length the length of the dump
+		 * @param extra the other dumped regions which must outlive the reader
+		 * @param numExtra the number of other regions
+		 */
+		DumpReader(uintptr_t base, const uint8_t *data, size_t length, const Region *extra=nullptr, size_t numExtra=0) :
+			data({base, data, length}), extra(extra), numExtra(numExtra) {}
+
+		uintptr_t base() const {
+			return data.addr;
+		}
+
+		size_t size() const {
+			return data.length;
+		}
+
+		bool read(uintptr_t addr, void *dst, size_t length) const {
+			if (addr >= data.addr && addr + length <= data.addr + data.length) [[likely]] {
+				memcpy(dst, data.data + (addr - data.addr), length);
+				return true;
+			}
+			for (size_t i = 0; i < numExtra; i++) {
+				const Region &region = extra[i];
+				if (addr >= region.addr && addr + length <= region.addr + region.length) {
+					memcpy(dst, region.data + (addr - region.addr), length);
+					return true;
+				}
+			}
+			return false;
+		}
+};
+
+// a qword matches when (value & mask) == expected
+struct QwordFilter {
+	uint64_t mask;
+	uint64_t expected;
+};
+
+/**
+ * Scans the data segment for qwords passing the filter, starting at the hint and moving outwards
+ * so that offsets close to the ones of a known firmware are found first
+ * @param reader the reader
+ * @param filter the filter checked with SIMD before the match is called
+ * @param hint the offset to start at
+ * @param match called with the offset and value of each filtered qword until it returns true
+ * @return the offset of the match or NOT_FOUND
+ */
+template <KernelReader Reader, typename Match>
+size_t scan(const Reader &reader, QwordFilter filter, size_t hint, Match &&match) {
+	static constexpr size_t CHUNK_SIZE = 0x10000;
+	UniquePtr<uint64_t[]> chunk{new uint64_t[CHUNK_SIZE / sizeof(uint64_t)]};
+	const __m256i mask = _mm256_set1_epi64x(filter.mask);
+	const __m256i expected = _mm256_set1_epi64x(filter.expected);
+
+	const size_t chunks = reader.size() / CHUNK_SIZE;
+	const size_t first = hint / CHUNK_SIZE < chunks ? hint / CHUNK_SIZE : chunks / 2;
+	// first, first + 1, first - 1, first + 2, ...
+	for (size_t i = 0; i < chunks * 2; i++) {
+		const size_t distance = (i + 1) / 2;
+		if ((i & 1) == 0 ? first < distance : first + distance >= chunks) {
+			continue;
+		}
+		const size_t index = (i & 1) == 0 ? first - distance : first + distance;
+		const size_t offset = index * CHUNK_SIZE;
+		if (!reader.read(reader.base() + offset, chunk.get(), CHUNK_SIZE)) [[unlikely]] {
+			continue;
+		}
+		for (size_t j = 0; j < CHUNK_SIZE / sizeof(uint64_t); j += 4) {
+			const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(chunk.get() + j));
+			const __m256i hits = _mm256_cmpeq_epi64(_mm256_and_si256(values, mask), expected);
+			uint32_t bits = _mm256_movemask_pd(_mm256_castsi256_pd(hits));
+			while (bits != 0) {
+				const size_t k = j + __builtin_ctz(bits);
+				bits &= bits - 1;
+				if (match(offset + k * sizeof(uint64_t), chunk[k])) {
+					return offset + k * sizeof(uint64_t);
+				}
+			}
+		}
+	}
+	return NOT_FOUND;
+}
+
+/**
+ * Checks that head is the allproc list, every entry links back to the previous one,
+ * has a sane pid and our own process is in it
+ * @param reader the reader
+ * @param head the kernel address of the candidate list head
+ * @param pid our pid
+ * @return true if the list is allproc
+ */
+template <KernelReader Reader>
+bool isProcList(const Reader &reader, uintptr_t head, int pid) {
+	static constexpr size_t MAX_PROCS = 0x1000;
+	static constexpr int MAX_PID = 0x100000;
+	constexpr layout::ProcLayout LAYOUT = layout::STRUCTS.proc;
+
+	uintptr_t prev = head;
+	uintptr_t proc = 0;
+	if (!reader.read(head, &proc, sizeof(proc))) {
+		return false;
+	}
+	bool found = false;
+	for (size_t i = 0; proc != 0; i++) {
+		if (i == MAX_PROCS) {
+			return false;
+		}
+		// p_list is first so the link, back link and pid are one read
+		alignas(8) uint8_t buf[LAYOUT.pid + sizeof(int)];
+		if (!reader.read(proc, buf, sizeof(buf))) {
+			return false;
+		}
+		const uintptr_t next = *(uintptr_t *)buf;
+		const uintptr_t back = *(uintptr_t *)(buf + sizeof(uintptr_t));
+		const int p = *(int *)(buf + LAYOUT.pid);
+		if (back != prev || p < 0 || p >= MAX_PID) {
+			return false;
+		}
+		found |= p == pid;
+		prev = proc;
+		proc = next;
+	}
+	return found;
+}
+
+/**
+ * Finds allproc by looking for a pointer into the heap which is a valid proc list
+ * @param reader the reader
+ * @param heap any heap address, only pointers near it are candidates
+ * @param pid our pid
+ * @param hint the offset to start searching at
+ * @return the offset from the data segment or NOT_FOUND
+ */
+template <KernelReader Reader>
+size_t findAllproc(const Reader &reader, uintptr_t heap, int pid, size_t hint) {
+	static constexpr unsigned int HEAP_SHIFT = 39;
+	const QwordFilter filter{~((1ULL << HEAP_SHIFT) - 1), (heap >> HEAP_SHIFT) << HEAP_SHIFT};
+	return scan(reader, filter, hint, [&reader, pid](size_t offset, uint64_t value) {
+		// cheap check first, the first proc's le_prev points at the head
+		uintptr_t back = 0;
+		const uintptr_t head = reader.base() + offset;
+		if (!reader.read(value + sizeof(uintptr_t), &back, sizeof(back)) || back != head) {
+			return false;
+		}
+		return isProcList(reader, head, pid);
+	});
+}
+
+/**
+ * Gets the root directory of the lowest pid, which is the system's root vnode
+ * since system processes are not sandboxed
+ * @param reader the reader
+ * @param allproc the kernel address of allproc
+ * @return the root vnode or 0 if it could not be read
+ */
+template <KernelReader Reader>
+uintptr_t getRootDirectory(const Reader &reader, uintptr_t allproc) {
+	constexpr layout::ProcLayout LAYOUT = layout::STRUCTS.proc;
+	uintptr_t proc = 0;
+	reader.read(allproc, &proc, sizeof(proc));
+	int lowest = -1;
+	uintptr_t vnode = 0;
+	while (proc != 0) {
+		alignas(8) uint8_t buf[LAYOUT.pid + sizeof(int)];
+		if (!reader.read(proc, buf, sizeof(buf))) {
+			return 0;
+		}
+		const int pid = *(int *)(buf + LAYOUT.pid);
+		uintptr_t fd = 0;
+		uintptr_t rdir = 0;
+		if ((lowest == -1 || pid < lowest) && reader.read(proc + LAYOUT.fd, &fd, sizeof(fd)) && fd != 0
+			&& reader.read(fd + layout::STRUCTS.filedesc.rdir, &rdir, sizeof(rdir)) && rdir != 0) {
+			lowest = pid;
+			vnode = rdir;
+		}
+		proc = *(uintptr_t *)buf;
+	}
+	return vnode;
+}
+
+/**
+ * Finds the global holding the root vnode
+ * @param reader the reader
+ * @param vnode the root vnode
+ * @param hint the offset to start searching at, other globals such as prison0's root
+ * hold the same vnode so the one closest to the hint is used
+ * @return the offset from the data segment or NOT_FOUND
+ */
+template <KernelReader Reader>
+size_t findRootVnode(const Reader &reader, uintptr_t vnode, size_t hint) {
+	return scan(reader, {~0ULL, vnode}, hint, [](size_t, uint64_t) {
+		return true;
+	});
+}
+
+/**
+ * Gets the layout of the closest known firmware for its offsets to be used as hints
+ * @param version the kern.sdk_version
+ * @return the layout
+ */
+constexpr const layout::KernelLayout &closest(uint32_t version) {
+	const layout::KernelLayout *best = &layout::LAYOUTS[0];
+	for (const layout::KernelLayout &layout : layout::LAYOUTS) {
+		if (layout.version <= (version & 0xffff0000)) {
+			best = &layout;
+		}
+	}
+	return *best;
+}
+
+/**
+ * Discovers the offsets of an unknown firmware
+ * security_flags, qa_flags and utoken_flags are left as -1 since nothing links to them
+ * @param reader the reader
+ * @param version the kern.sdk_version
+ * @param heap any heap address used to tell which pointers are safe to follow
+ * @param pid our pid
+ * @param result the layout to fill in
+ * @return true if allproc and root_vnode were found
+ */
+template <KernelReader Reader>
+bool discover(const Reader &reader, uint32_t version, uintptr_t heap, int pid, layout::KernelLayout &result) {
+	const layout::KernelLayout &hint = closest(version);
+	result = layout::UNSUPPORTED;
+	result.version = version & 0xffff0000;
+
+	const size_t allproc = findAllproc(reader, heap, pid, hint.allproc);
+	if (allproc == NOT_FOUND) {
+		return false;
+	}
+	const uintptr_t vnode = getRootDirectory(reader, reader.base() + allproc);
+	if (vnode == 0) {
+		return false;
+	}
+	const size_t rootVnode = findRootVnode(reader, vnode, hint.root_vnode);
+	if (rootVnode == NOT_FOUND) {
+		return false;
+	}
+	result.allproc = allproc;
+	result.root_vnode = rootVnode;
+	return true;
+}
+
+/**
+ * Loads offsets discovered in a previous session
+ * @param version the kern.sdk_version
+ * @param result the layout to fill in
+ * @return true if the firmware was in the cache
+ */
+bool load(uint32_t version, layout::KernelLayout &result);
+
+/**
+ * Stores discovered offsets for the next session
+ * @param result the discovered layout
+ */
+void save(const layout::KernelLayout &result);
+
+} // discovery
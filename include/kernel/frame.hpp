@@ -10,6 +10,7 @@ class TrapFrame : public KernelObject<TrapFrame, 0x110> {
 
 		TrapFrame &setFrame(const TrapFrame *frame) {
 			memcpy(buf, frame->buf, sizeof(buf));
+			setDirty(0, sizeof(buf));
 			return *this;
 		}
 
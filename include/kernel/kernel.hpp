@@ -1,11 +1,13 @@
 #pragma once
 
+#include "layout.hpp"
 #include "util.hpp"
 #include <sys/_stdint.h>
 
 extern "C" {
 
 #include <ps5/kernel.h>
+#include "kernel_helpers.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
@@ -29,6 +31,16 @@ void kread(uintptr_t addr, uint8_t(&buf)[length]) {
 	kernel_copyout(addr, buf, length);
 }
 
+/**
+ * Reads multiple scattered ranges with a single acquisition of the kernel r/w primitive
+ * Consecutive ranges which follow each other are read without moving the pipe
+ * @param ops the ranges to read, a ksrc of 0 is skipped
+ * @param n the number of ops
+ */
+inline void kreadv(const kernel_readop *ops, size_t n) {
+	kernel_copyoutv(ops, n);
+}
+
 template <typename T>
 void kwrite(uintptr_t addr, const T& value) {
 	kernel_copyin(const_cast<T *>(&value), addr, sizeof(T));
@@ -56,12 +68,32 @@ concept KernelObjectBase = SizedKernelObject<T> && DerivedKernelObject<T>;
 template<KernelObjectBase T>
 class KIterable;
 
+/**
+ * Reads a NUL terminated string from kernel memory
+ * @param addr the address of the string
+ * @return the string
+ */
 String getKernelString(uintptr_t addr);
 
+/**
+ * Reads a kernel string once per address for the rest of the session
+ * Only for strings which live as long as their owner such as library paths
+ * A hit is checked against a single read of the start of the string in case the address was reused
+ * @param addr the address of the string
+ * @return the string
+ */
+String getInternedKernelString(uintptr_t addr);
+
+/**
+ * Forgets every interned kernel string
+ */
+void clearKernelStringCache();
+
 template <typename ObjBase, unsigned long size>
 class KernelObject {
 
 	uintptr_t addr;
+	DirtyMask<size> dirty{};
 
 	protected:
 		template<KernelObjectBase Base>
@@ -81,6 +113,7 @@ class KernelObject {
 
 		void reload() {
 			kernel_copyout(addr, buf, size);
+			dirty.clear();
 		}
 
 		template<typename T, const unsigned long offset>
@@ -91,8 +124,18 @@ class KernelObject {
 
 		template<const unsigned long offset, typename T>
 		void set(T value) {
-			static_assert(offset < size, "offset >= size");
+			static_assert(offset + sizeof(T) <= size, "offset + sizeof(T) > size");
 			*(T *)(buf + offset) = value;
+			dirty.mark(offset, sizeof(T));
+		}
+
+		/**
+		 * Marks bytes which were written directly into buf for the next flush
+		 * @param offset the offset of the first byte
+		 * @param length the number of bytes
+		 */
+		void setDirty(size_t offset, size_t length) {
+			dirty.mark(offset, length);
 		}
 
 		template<const unsigned long offset>
@@ -120,17 +163,40 @@ class KernelObject {
 			return addr;
 		}
 
-		void flush() const {
+		bool isDirty() const {
+			return !dirty.empty();
+		}
+
+		/**
+		 * Writes back only the bytes changed since the object was read or last flushed
+		 * so that fields the kernel updated in the meantime are not clobbered
+		 */
+		void flush() {
 			#ifdef DEBUG
 			if (!addr) [[unlikely]] {
 				fatalf("nullptr dereference\n");
 			}
 			#endif
-			kernel_copyin(const_cast<uint8_t *>(buf), addr, size);
+			dirty.forEachSpan([this](size_t offset, size_t length) {
+				kernel_copyin(buf + offset, addr + offset, length);
+			});
+			dirty.clear();
 		}
 };
 
 
+/**
+ * Reads a kernel object once, applies the changes and writes back only what changed
+ * @param addr the address of the object
+ * @param modifier called with the object to change it through its setters
+ */
+template <KernelObjectBase T, typename Modifier>
+void modify(uintptr_t addr, Modifier &&modifier) {
+	T obj{addr};
+	modifier(obj);
+	obj.flush();
+}
+
 template<typename T>
 class KPointer {
 
@@ -192,6 +258,89 @@ class KIterable {
 		explicit operator bool() const { return addr; }
 };
 
+// a node of a kernel list of which only the first prefix bytes were read
+// the link to the next node is at offset 0 in every list walked here
+template<KernelObjectBase T, size_t prefix>
+class KNode {
+
+	static_assert(prefix >= sizeof(uintptr_t), "prefix must include the link");
+	static_assert(prefix <= T::length, "prefix > T::length");
+
+	uintptr_t addr;
+	uint8_t buf[prefix];
+
+	public:
+		KNode(uintptr_t addr) : addr(addr) {
+			if (addr != 0) {
+				kernel_copyout(addr, buf, prefix);
+			}
+		}
+
+		uintptr_t address() const {
+			return addr;
+		}
+
+		uintptr_t next() const {
+			return *(uintptr_t *)buf;
+		}
+
+		template<typename U, const unsigned long offset>
+		U get() const {
+			static_assert(offset + sizeof(U) <= prefix, "field is not prefetched");
+			return *(U *)(buf + offset);
+		}
+};
+
+// walks a kernel list with one copyout per node by reading the link together with the fields
+template<KernelObjectBase T, size_t prefix>
+class KPrefetchIterable {
+
+	KNode<T, prefix> node;
+
+	public:
+		KPrefetchIterable(uintptr_t addr) : node(addr) {}
+
+		const KNode<T, prefix> &operator*() const {
+			return node;
+		}
+
+		bool operator!=(decltype(nullptr)) const { return node.address() != 0; }
+
+		KPrefetchIterable &operator++() {
+			node = KNode<T, prefix>{node.next()};
+			return *this;
+		}
+};
+
+template<KernelObjectBase T, size_t prefix>
+struct KPrefetchIterator {
+
+	const uintptr_t first;
+
+	KPrefetchIterator(uintptr_t first) : first(first) {}
+	KPrefetchIterable<T, prefix> begin() const {
+		return first;
+	}
+	decltype(nullptr) end() const {
+		return nullptr;
+	}
+
+	/**
+	 * Finds the first node matching the predicate without reading the rest of the list
+	 * @param predicate called with each KNode until it returns true
+	 * @return the address of the node or 0 if not found
+	 */
+	template<typename Predicate>
+	uintptr_t find(Predicate &&predicate) const {
+		for (const auto &node : *this) {
+			if (predicate(node)) {
+				return node.address();
+			}
+		}
+		return 0;
+	}
+};
+
 template<KernelObjectBase T>
 struct KIterator {
 
@@ -205,18 +354,63 @@ struct KIterator {
 		return nullptr;
 	}
 
+	/**
+	 * Iterates the list reading only the first prefix bytes of each node
+	 * @tparam prefix the number of bytes to read which must cover the fields used
+	 * @return the iterator starting at the first node after the list head
+	 */
+	template<size_t prefix>
+	KPrefetchIterator<T, prefix> prefetch() const {
+		return {kread<uintptr_t>(addr)};
+	}
+
 };
 
 class KUcred : public KernelObject<KUcred, 0x168> {
 
+	static constexpr layout::UcredLayout LAYOUT = layout::STRUCTS.ucred;
+
 	public:
 		KUcred(uintptr_t addr) : KernelObject(addr) {}
 
 		uint64_t authid() const {
-			return get<uint64_t, 0x58>();
+			return get<uint64_t, LAYOUT.authid>();
 		}
 
 		void authid(uint64_t value) {
-			set<0x58>(value);
+			set<LAYOUT.authid>(value);
+		}
+
+		void uid(uint32_t value) {
+			set<LAYOUT.uid>(value);
+		}
+
+		void ruid(uint32_t value) {
+			set<LAYOUT.ruid>(value);
+		}
+
+		void svuid(uint32_t value) {
+			set<LAYOUT.svuid>(value);
+		}
+
+		void ngroups(uint32_t value) {
+			set<LAYOUT.ngroups>(value);
+		}
+
+		void rgid(uint32_t value) {
+			set<LAYOUT.rgid>(value);
+		}
+
+		void caps(size_t i, uint64_t value) {
+			// there are only two of them
+			if (i == 0) {
+				set<LAYOUT.caps>(value);
+			} else {
+				set<LAYOUT.caps + sizeof(uint64_t)>(value);
+			}
+		}
+
+		void attr(uint8_t value) {
+			set<LAYOUT.attr>(value);
 		}
 };
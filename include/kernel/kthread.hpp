@@ -5,15 +5,22 @@
 class KThread : public KernelObject<KThread, 0x680> {
 
 	public:
+		static constexpr unsigned long TID_OFFSET = layout::STRUCTS.thread.tid;
+		static constexpr unsigned long FRAME_OFFSET = layout::STRUCTS.thread.frame;
+
 		KThread(uintptr_t addr) : KernelObject(addr) {}
 
 		UniquePtr<TrapFrame> getFrame() {
-			uintptr_t ptr = get<uintptr_t, 0x460>();
+			uintptr_t ptr = td_frame();
 			return ptr ? new TrapFrame(ptr) : nullptr;
 		}
 
+		uintptr_t td_frame() const {
+			return get<uintptr_t, FRAME_OFFSET>();
+		}
+
 		int tid() const {
-			return get<int, 0x9c>();
+			return get<int, TID_OFFSET>();
 		}
 };
 
@@ -0,0 +1,228 @@
+#pragma once
+
+extern "C" {
+	#include <stddef.h>
+	#include <stdint.h>
+}
+
+namespace layout {
+
+struct ProcLayout {
+	unsigned long threads;
+	unsigned long ucred;
+	unsigned long fd;
+	unsigned long pid;
+	unsigned long vmspace;
+	unsigned long sharedObject;
+	unsigned long selfInfo;
+	unsigned long name;
+
+	constexpr bool operator==(const ProcLayout &rhs) const = default;
+};
+
+struct ThreadLayout {
+	unsigned long tid;
+	unsigned long frame;
+
+	constexpr bool operator==(const ThreadLayout &rhs) const = default;
+};
+
+struct SharedLibLayout {
+	unsigned long path;
+	unsigned long handle;
+	unsigned long sections;
+	unsigned long numSections;
+	unsigned long imagebase;
+	unsigned long dynlibData;
+
+	constexpr bool operator==(const SharedLibLayout &rhs) const = default;
+};
+
+struct UcredLayout {
+	unsigned long uid;
+	unsigned long ruid;
+	unsigned long svuid;
+	unsigned long ngroups;
+	unsigned long rgid;
+	unsigned long authid;
+	unsigned long caps;
+	unsigned long attr;
+
+	constexpr bool operator==(const UcredLayout &rhs) const = default;
+};
+
+struct FiledescLayout {
+	unsigned long rdir;
+	unsigned long jdir;
+
+	constexpr bool operator==(const FiledescLayout &rhs) const = default;
+};
+
+struct VmMapEntryLayout {
+	unsigned long size;
+	unsigned long prev;
+	unsigned long next;
+	unsigned long start;
+	unsigned long end;
+	unsigned long object;
+	unsigned long offset;
+	unsigned long protection;
+	unsigned long maxProtection;
+
+	constexpr bool operator==(const VmMapEntryLayout &rhs) const = default;
+};
+
+// offsets into the kernel's structures
+struct StructLayout {
+	ProcLayout proc;
+	ThreadLayout thread;
+	SharedLibLayout sharedLib;
+	UcredLayout ucred;
+	FiledescLayout filedesc;
+	VmMapEntryLayout vmMapEntry;
+
+	constexpr bool operator==(const StructLayout &rhs) const = default;
+};
+
+struct KernelLayout {
+	uint32_t version; // kern.sdk_version & 0xffff0000
+
+	// offsets from kernel_base
+	size_t allproc;
+	size_t security_flags;
+	size_t qa_flags;
+	size_t utoken_flags;
+	size_t root_vnode;
+
+	StructLayout structs;
+};
+
+inline constexpr StructLayout STRUCTS_300{
+	.proc = {
+		.threads = 0x10,
+		.ucred = 0x40,
+		.fd = 0x48,
+		.pid = 0xbc,
+		.vmspace = 0x200,
+		.sharedObject = 0x3e8,
+		.selfInfo = 0x588,
+		.name = 0x59c
+	},
+	.thread = {
+		.tid = 0x9c,
+		.frame = 0x460
+	},
+	.sharedLib = {
+		.path = 0x8,
+		.handle = 0x28,
+		.sections = 0x40,
+		.numSections = 0x48,
+		.imagebase = 0x30,
+		.dynlibData = 0x148
+	},
+	.ucred = {
+		.uid = 0x04,
+		.ruid = 0x08,
+		.svuid = 0x0c,
+		.ngroups = 0x10,
+		.rgid = 0x14,
+		.authid = 0x58,
+		.caps = 0x60,
+		.attr = 0x83
+	},
+	.filedesc = {
+		.rdir = 0x10,
+		.jdir = 0x18
+	},
+	.vmMapEntry = {
+		.size = 0x60,
+		.prev = 0x0,
+		.next = 0x8,
+		.start = 0x20,
+		.end = 0x28,
+		.object = 0x48,
+		.offset = 0x50,
+		.protection = 0x5c,
+		.maxProtection = 0x5d
+	}
+};
+
+// adding a firmware only requires adding its entry here
+inline constexpr KernelLayout LAYOUTS[] = {
+	{0x3000000, 0x276DC58, 0x6466474, 0x6466498, 0x6466500, 0x67AB4C0, STRUCTS_300},
+	{0x3100000, 0x276DC58, 0x6466474, 0x6466498, 0x6466500, 0x67AB4C0, STRUCTS_300},
+	{0x3200000, 0x276DC58, 0x6466474, 0x6466498, 0x6466500, 0x67AB4C0, STRUCTS_300},
+	{0x3210000, 0x276DC58, 0x6466474, 0x6466498, 0x6466500, 0x67AB4C0, STRUCTS_300},
+	{0x4020000, 0x27EDCB8, 0x6505474, 0x6505498, 0x6505500, 0x66E64C0, STRUCTS_300},
+	{0x4030000, 0x27EDCB8, 0x6506474, 0x6506498, 0x6506500, 0x66E74C0, STRUCTS_300},
+	{0x4500000, 0x27EDCB8, 0x6506474, 0x6506498, 0x6506500, 0x66E74C0, STRUCTS_300},
+	{0x4510000, 0x27EDCB8, 0x6506474, 0x6506498, 0x6506500, 0x66E74C0, STRUCTS_300},
+};
+
+// returned for firmwares which are not in the table
+inline constexpr KernelLayout UNSUPPORTED{
+	0, (size_t) -1, (size_t) -1, (size_t) -1, (size_t) -1, (size_t) -1, STRUCTS_300
+};
+
+/**
+ * Finds the layout for a firmware
+ * @param version the kern.sdk_version
+ * @return the layout or nullptr if the firmware is not supported
+ */
+constexpr const KernelLayout *find(uint32_t version) {
+	for (const KernelLayout &layout : LAYOUTS) {
+		if (layout.version == (version & 0xffff0000)) {
+			return &layout;
+		}
+	}
+	return nullptr;
+}
+
+constexpr bool haveSameStructs() {
+	for (const KernelLayout &layout : LAYOUTS) {
+		if (!(layout.structs == LAYOUTS[0].structs)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// PS5_FW_VERSION is 0xMmm such as 0x403 for 4.03 and may be defined empty for builds supporting every firmware
+#ifdef PS5_FW_VERSION
+inline constexpr uint32_t BUILD_VERSION = (uint32_t) (PS5_FW_VERSION + 0) << 16;
+#else
+inline constexpr uint32_t BUILD_VERSION = 0;
+#endif
+
+inline constexpr const KernelLayout *BUILD_LAYOUT = BUILD_VERSION != 0 ? find(BUILD_VERSION) : nullptr;
+
+static_assert(BUILD_VERSION == 0 || BUILD_LAYOUT != nullptr, "PS5_FW_VERSION is not in layout::LAYOUTS");
+
+// the struct offsets are template arguments so they must be known at compile time
+// a firmware specific build uses its own, other builds require every firmware to agree
+static_assert(BUILD_LAYOUT != nullptr || haveSameStructs(), "struct layouts differ, build for a specific PS5_FW_VERSION");
+
+inline constexpr StructLayout STRUCTS = BUILD_LAYOUT != nullptr ? BUILD_LAYOUT->structs : LAYOUTS[0].structs;
+
+/**
+ * Looks up the layout for the running firmware, only done on the first call
+ * @return the layout which is UNSUPPORTED for unknown firmwares
+ */
+const KernelLayout &detect();
+
+/**
+ * Checks that a firmware specific build is running on the firmware it was built for
+ * current() trusts the build so this must be done once at startup before the layout is used
+ * @return false if the running firmware is not PS5_FW_VERSION
+ */
+bool matchesRunningFirmware();
+
+inline const KernelLayout &current() {
+	if constexpr (BUILD_LAYOUT != nullptr) {
+		return *BUILD_LAYOUT;
+	} else {
+		return detect();
+	}
+}
+
+} // layout
@@ -28,13 +28,15 @@ static_assert(sizeof(SelfInfo) == 0x400, "sizeof(SelfInfo) != 0x400");
 class Filedescent : public KernelObject<Filedescent, 0x30> {
 
 	public:
+		static constexpr unsigned long FLAGS_OFFSET = 0x28;
+
 		Filedescent(uintptr_t addr) : KernelObject(addr) {}
 		uintptr_t file() const {
 			return get<uintptr_t, 0>();
 		}
 
 		uint8_t flags() const {
-			return get<uint8_t, 0x28>();
+			return get<uint8_t, FLAGS_OFFSET>();
 		}
 
 		uint32_t seq() const {
@@ -42,6 +44,13 @@ class Filedescent : public KernelObject<Filedescent, 0x30> {
 		}
 };
 
+struct FdEntry {
+	int fd;
+	uint8_t flags;
+	uintptr_t file;
+	uintptr_t data; // f_data
+};
+
 class FdTbl {
 	uintptr_t addr;
 	size_t ntables;
@@ -87,15 +96,26 @@ class FdTbl {
 		size_t length() const {
 			return ntables;
 		}
+
+		/**
+		 * Copies the open files in [begin, end) with two kernel reads instead of two per fd
+		 * @param begin the first fd
+		 * @param end the fd past the last one, clamped to the table length
+		 * @return the open files in fd order
+		 */
+		Array<FdEntry> snapshot(size_t begin=0, size_t end=SIZE_MAX) const;
 };
 
 class KProc : public KernelObject<KProc, 0xc90> {
 
 	public:
+		static constexpr layout::ProcLayout LAYOUT = layout::STRUCTS.proc;
+		static constexpr unsigned long PID_OFFSET = LAYOUT.pid;
+		static constexpr unsigned long THREADS_OFFSET = LAYOUT.threads;
 
 		KProc(uintptr_t addr) : KernelObject(addr) {}
 		uintptr_t p_ucred() const {
-			return get<uintptr_t, 0x40>();
+			return get<uintptr_t, LAYOUT.ucred>();
 		}
 
 		UniquePtr<KUcred> ucred() const {
@@ -103,7 +123,7 @@ class KProc : public KernelObject<KProc, 0xc90> {
 		}
 
 		int p_pid() const {
-			return get<int, 0xbc>();
+			return get<int, PID_OFFSET>();
 		}
 
 		int pid() const {
@@ -111,11 +131,11 @@ class KProc : public KernelObject<KProc, 0xc90> {
 		}
 
 		UniquePtr<SharedObject> getSharedObject() const {
-			return new SharedObject{get<uintptr_t, 0x3e8>(), pid()};
+			return new SharedObject{get<uintptr_t, LAYOUT.sharedObject>(), pid()};
 		}
 
 		KIterator<KThread> p_threads() const {
-			return address() + 0x10;
+			return address() + THREADS_OFFSET;
 		}
 
 		KIterator<KThread> getThreads() const {
@@ -123,30 +143,33 @@ class KProc : public KernelObject<KProc, 0xc90> {
 		}
 
 		UniquePtr<KThread> getThread(int tid) const {
-			for (auto td : getThreads()) {
-				if (tid == td->tid()) {
-					return td.release();
-				}
-			}
-			return nullptr;
+			constexpr size_t prefix = KThread::TID_OFFSET + sizeof(int);
+			const uintptr_t td = getThreads().prefetch<prefix>().find([tid](const KNode<KThread, prefix> &node) {
+				return node.get<int, KThread::TID_OFFSET>() == tid;
+			});
+			return td != 0 ? new KThread{td} : nullptr;
 		}
 
 		uintptr_t p_fd() const {
-			return get<uintptr_t, 0x48>();
+			return get<uintptr_t, LAYOUT.fd>();
 		}
 
 		FdTbl getFdTbl() const {
 			return {kread<uintptr_t>(p_fd())};
 		}
 
+		uintptr_t p_vmspace() const {
+			return get<uintptr_t, LAYOUT.vmspace>();
+		}
+
 		const SelfInfo *getSelfInfo() const {
-			return (SelfInfo *) (buf + 0x588);
+			return (SelfInfo *) (buf + LAYOUT.selfInfo);
 		}
 
 		// no flush required
 		void setName(const String &name, bool reload=false) {
 			const size_t length = name.length() < 0x1f ? name.length() : 0x20;
-			kernel_copyin(const_cast<char*>(name.c_str()), address() + 0x59C, length);
+			kernel_copyin(const_cast<char*>(name.c_str()), address() + LAYOUT.name, length);
 			if (reload) {
 				this->reload();
 			}
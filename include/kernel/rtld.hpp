@@ -93,31 +93,34 @@ class SharedLib : public KernelObject<SharedLib, 0x200> {
 	mutable UniquePtr<RtldMeta> meta;
 
 	uintptr_t getDynlibData() const {
-		return get<uintptr_t, 0x148>();
+		return get<uintptr_t, LAYOUT.dynlibData>();
 	}
 
 	public:
+		static constexpr layout::SharedLibLayout LAYOUT = layout::STRUCTS.sharedLib;
+		static constexpr unsigned long PATH_OFFSET = LAYOUT.path;
+		static constexpr unsigned long HANDLE_OFFSET = LAYOUT.handle;
+
 		const int pid;
 
 		SharedLib(uintptr_t addr, int pid)
 			: KernelObject(addr), path(nullptr), sections(nullptr), meta(nullptr), pid(pid) {}
 
 		int handle() const {
-			return get<int, 0x28>();
+			return get<int, HANDLE_OFFSET>();
 		}
 
 		StringView getPath() const {
-			__builtin_printf("SharedLib::getPath 0x%llx\n", (unsigned long long)get<uintptr_t, 8>());
 			if (path.length() == 0) [[unlikely]] {
-				path = getString<8>();
+				path = getInternedKernelString(get<uintptr_t, PATH_OFFSET>());
 			}
 			return {path.c_str(), path.length()};
 		}
 
 		const Array<SharedLibSection> &getSections() const {
 			if (sections == nullptr) [[unlikely]] {
-				size_t numSections = get<size_t, 0x48>();
-				uintptr_t ptr = get<uintptr_t, 0x40>();
+				size_t numSections = get<size_t, LAYOUT.numSections>();
+				uintptr_t ptr = get<uintptr_t, LAYOUT.sections>();
 				sections = Array<SharedLibSection>{numSections};
 				for (size_t i = 0; i < numSections; i++) {
 					sections[i] = SharedLibSection{ptr + (i * SharedLibSection::length)};
@@ -165,11 +168,11 @@ class SharedLib : public KernelObject<SharedLib, 0x200> {
 		}
 
 		uintptr_t imagebase() const {
-			return get<uintptr_t, 0x30>();
+			return get<uintptr_t, LAYOUT.imagebase>();
 		}
 
 		void imagebase(uintptr_t base) {
-			kwrite<uintptr_t>(address() + 0x30, base);
+			kwrite<uintptr_t>(address() + LAYOUT.imagebase, base);
 		}
 
 		RtldMeta *getMetaData() const {
@@ -257,6 +260,16 @@ struct SharedLibIterator {
 		return nullptr;
 	}
 
+	/**
+	 * Iterates the libraries reading only the first prefix bytes of each one
+	 * @tparam prefix the number of bytes to read which must cover the fields used
+	 * @return the iterator
+	 */
+	template<size_t prefix>
+	KPrefetchIterator<SharedLib, prefix> prefetch() const {
+		return {addr};
+	}
+
 };
 
 class SharedObject : KernelObject<SharedObject, 0x188> {
@@ -281,21 +294,19 @@ class SharedObject : KernelObject<SharedObject, 0x188> {
 		}
 
 		UniquePtr<SharedLib> getLib(int handle) {
-			for (auto lib : getLibs()) {
-				if (lib->handle() == handle) {
-					return lib;
-				}
-			}
-			return nullptr;
+			constexpr size_t prefix = SharedLib::HANDLE_OFFSET + sizeof(int);
+			const uintptr_t lib = getLibs().prefetch<prefix>().find([handle](const KNode<SharedLib, prefix> &node) {
+				return node.get<int, SharedLib::HANDLE_OFFSET>() == handle;
+			});
+			return lib != 0 ? new SharedLib{lib, pid} : nullptr;
 		}
 
 		UniquePtr<SharedLib> getLib(const StringView &name) const {
-			for (auto lib : getLibs()) {
-				if (lib->getPath().endswith(name)) {
-					return lib;
-				}
-			}
-			return nullptr;
+			constexpr size_t prefix = SharedLib::PATH_OFFSET + sizeof(uintptr_t);
+			const uintptr_t lib = getLibs().prefetch<prefix>().find([&name](const KNode<SharedLib, prefix> &node) {
+				return getInternedKernelString(node.get<uintptr_t, SharedLib::PATH_OFFSET>()).endswith(name);
+			});
+			return lib != 0 ? new SharedLib{lib, pid} : nullptr;
 		}
 };
 
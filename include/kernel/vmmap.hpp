@@ -0,0 +1,112 @@
+#pragma once
+
+#include "kernel.hpp"
+#include "util.hpp"
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+}
+
+class KProc;
+
+class KVmMapEntry : public KernelObject<KVmMapEntry, layout::STRUCTS.vmMapEntry.size> {
+
+	static constexpr layout::VmMapEntryLayout LAYOUT = layout::STRUCTS.vmMapEntry;
+
+	public:
+		KVmMapEntry(uintptr_t addr) : KernelObject(addr) {}
+
+		uintptr_t prev() const {
+			return get<uintptr_t, LAYOUT.prev>();
+		}
+
+		uintptr_t next() const {
+			return get<uintptr_t, LAYOUT.next>();
+		}
+
+		uintptr_t start() const {
+			return get<uintptr_t, LAYOUT.start>();
+		}
+
+		uintptr_t end() const {
+			return get<uintptr_t, LAYOUT.end>();
+		}
+
+		uintptr_t object() const {
+			return get<uintptr_t, LAYOUT.object>();
+		}
+
+		uint64_t offset() const {
+			return get<uint64_t, LAYOUT.offset>();
+		}
+
+		uint8_t protection() const {
+			return get<uint8_t, LAYOUT.protection>();
+		}
+
+		uint8_t maxProtection() const {
+			return get<uint8_t, LAYOUT.maxProtection>();
+		}
+};
+
+struct VmMapEntry {
+	uintptr_t start;
+	uintptr_t end;
+	uintptr_t object;
+	uint8_t protection;
+	uint8_t maxProtection;
+};
+
+// a snapshot of the mappings in a process's address space sorted by address
+class VmMap {
+	static constexpr size_t MAX_ENTRIES = 0x4000;
+
+	Array<VmMapEntry> entries;
+	size_t count;
+	uintptr_t minAddress;
+	uintptr_t maxAddress;
+
+	VmMap(Array<VmMapEntry> &&entries, size_t count, uintptr_t minAddress, uintptr_t maxAddress) :
+		entries(static_cast<Array<VmMapEntry>&&>(entries)), count(count), minAddress(minAddress), maxAddress(maxAddress) {}
+
+	public:
+		/**
+		 * Walks the map entries of the process's vmspace
+		 * @param proc the process
+		 * @return the map or nullptr if the entries could not be read
+		 */
+		static UniquePtr<VmMap> read(const KProc &proc);
+
+		size_t length() const {
+			return count;
+		}
+
+		const VmMapEntry &operator[](size_t i) const {
+			return entries[i];
+		}
+
+		const VmMapEntry *begin() const {
+			return entries.begin();
+		}
+
+		const VmMapEntry *end() const {
+			return entries.begin() + count;
+		}
+
+		/**
+		 * Finds the mapping containing the address
+		 * @param addr the address
+		 * @return the entry or nullptr if the address is not mapped
+		 */
+		const VmMapEntry *find(uintptr_t addr) const;
+
+		/**
+		 * Finds the lowest unmapped range at or above the hint
+		 * @param size the size of the range
+		 * @param align the alignment of the range which must be a power of two
+		 * @param hint the lowest acceptable address
+		 * @return the start of the range or 0 if there is no space
+		 */
+		uintptr_t findFree(size_t size, size_t align, uintptr_t hint=0) const;
+};
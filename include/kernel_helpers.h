@@ -11,6 +11,15 @@ void kernel_init_rw(int master_sock, int victim_sock, int *rw_pipe, uint64_t pip
 void kernel_copyin(void *src, uint64_t kdest, size_t length);
 void kernel_copyout(uint64_t ksrc, void *dest, size_t length);
 
+struct kernel_readop {
+	uint64_t ksrc;
+	void *dest;
+	size_t length;
+};
+
+// Reads multiple ranges while holding the primitive, ops with a ksrc of 0 are skipped.
+void kernel_copyoutv(const struct kernel_readop *ops, size_t n);
+
 #ifdef __cplusplus
 }
 #endif
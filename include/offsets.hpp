@@ -1,3 +1,6 @@
+#pragma once
+
+#include "kernel/layout.hpp"
 
 extern "C" {
 	#include <stddef.h>
@@ -5,10 +8,24 @@ extern "C" {
 
 namespace offsets {
 
-size_t allproc();
-size_t security_flags();
-size_t qa_flags();
-size_t utoken_flags();
-size_t root_vnode();
+inline size_t allproc() {
+	return layout::current().allproc;
+}
+
+inline size_t security_flags() {
+	return layout::current().security_flags;
+}
+
+inline size_t qa_flags() {
+	return layout::current().qa_flags;
+}
+
+inline size_t utoken_flags() {
+	return layout::current().utoken_flags;
+}
+
+inline size_t root_vnode() {
+	return layout::current().root_vnode;
+}
 
 } // offsets
@@ -41,9 +41,7 @@ class UniquePtr {
 		UniquePtr(T *ptr) : ptr(ptr) {}
 		UniquePtr(const UniquePtr &rhs) = delete;
 		UniquePtr &operator=(const UniquePtr &rhs) = delete;
-		UniquePtr(UniquePtr &&rhs) {
-			delete ptr;
-			ptr = rhs.ptr;
+		UniquePtr(UniquePtr &&rhs) : ptr(rhs.ptr) {
 			rhs.ptr = nullptr;
 		}
 		UniquePtr &operator=(UniquePtr &&rhs) {
@@ -101,9 +99,7 @@ class UniquePtr<T[]> {
 		UniquePtr(T *ptr) : ptr(ptr) {}
 		UniquePtr(const UniquePtr &rhs) = delete;
 		UniquePtr &operator=(const UniquePtr &rhs) = delete;
-		UniquePtr(UniquePtr &&rhs) {
-			delete[] ptr;
-			ptr = rhs.ptr;
+		UniquePtr(UniquePtr &&rhs) : ptr(rhs.ptr) {
 			rhs.ptr = nullptr;
 		}
 		UniquePtr &operator=(UniquePtr &&rhs) {
@@ -441,6 +437,67 @@ class Array {
 		T *data() { return ptr.get(); }
 };
 
+// byte granular dirty tracking for write-back caches
+template <size_t size>
+class DirtyMask {
+	static constexpr size_t WORDS = (size + 63) / 64;
+	uint64_t bits[WORDS];
+
+	public:
+		constexpr DirtyMask() : bits() {}
+
+		void mark(size_t offset, size_t length) {
+			#ifdef DEBUG
+			if (offset + length > size) [[unlikely]] {
+				fatalf("dirty range 0x%llx-0x%llx is out of bounds for size 0x%llx\n", offset, offset + length, size);
+			}
+			#endif
+			for (size_t i = offset; i < offset + length; i++) {
+				bits[i >> 6] |= 1ULL << (i & 63);
+			}
+		}
+
+		void markAll() {
+			mark(0, size);
+		}
+
+		void clear() {
+			__builtin_memset(bits, 0, sizeof(bits));
+		}
+
+		bool test(size_t i) const {
+			return bits[i >> 6] & (1ULL << (i & 63));
+		}
+
+		bool empty() const {
+			for (size_t i = 0; i < WORDS; i++) {
+				if (bits[i] != 0) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/**
+		 * Invokes fn(offset, length) for every contiguous dirty span
+		 */
+		template <typename Fn>
+		void forEachSpan(Fn fn) const {
+			size_t i = 0;
+			while (i < size) {
+				if (!test(i)) {
+					i++;
+					continue;
+				}
+				const size_t start = i;
+				while (i < size && test(i)) {
+					i++;
+				}
+				fn(start, i - start);
+			}
+		}
+};
+
 template <typename T>
 class List;
 
@@ -0,0 +1,153 @@
+#pragma once
+
+extern "C" {
+	#include <stdint.h>
+	#include <stddef.h>
+}
+
+/**
+ * Gets the time from the monotonic clock
+ * @return the time in microseconds
+ */
+uint64_t getMicroseconds();
+
+void waitSleep(uint32_t micros);
+void waitYield();
+
+class Deadline {
+	uint64_t end;
+
+	constexpr Deadline(uint64_t end) : end(end) {}
+
+	public:
+		static constexpr Deadline never() {
+			return {UINT64_MAX};
+		}
+
+		/**
+		 * @param micros the number of microseconds from now
+		 * @return the deadline
+		 */
+		static Deadline after(uint64_t micros) {
+			return {getMicroseconds() + micros};
+		}
+
+		bool isNever() const {
+			return end == UINT64_MAX;
+		}
+
+		bool expired(uint64_t now) const {
+			return now >= end;
+		}
+};
+
+// how a wait backs off while the condition isn't met
+// it pauses, then yields and then sleeps for twice as long each time up to maxSleep
+// a maxSleep of 0 is for predicates which block on their own
+struct BackoffPolicy {
+	uint32_t spins;
+	uint32_t yields;
+	uint32_t minSleep; // microseconds
+	uint32_t maxSleep; // microseconds
+
+	// handshakes with shellcode which finishes quickly
+	static constexpr BackoffPolicy fast() {
+		return {0x1000, 0x10, 10, 1000};
+	}
+
+	// conditions which take milliseconds to seconds such as a process starting
+	static constexpr BackoffPolicy slow() {
+		return {0, 0, 1, 10000};
+	}
+
+	static constexpr BackoffPolicy blocking() {
+		return {0, 0, 0, 0};
+	}
+};
+
+// accumulates how long the waits at one call site took
+// sites are expected to have static storage duration
+class WaitSite {
+	static constexpr size_t NUM_BUCKETS = 32;
+
+	const char *name;
+	WaitSite *next;
+	uint64_t buckets[NUM_BUCKETS]; // bucket i counts waits of [2^i, 2^(i+1)) microseconds
+	uint64_t count;
+	uint64_t timeouts;
+	uint64_t total;
+	uint64_t longest;
+	bool registered;
+
+	void add();
+
+	public:
+		constexpr WaitSite(const char *name) :
+			name(name), next(), buckets(), count(), timeouts(), total(), longest(), registered() {}
+		WaitSite(const WaitSite&) = delete;
+		WaitSite &operator=(const WaitSite&) = delete;
+
+		/**
+		 * Records the result of a wait
+		 * @param micros the time spent waiting
+		 * @param timedOut if the deadline was reached
+		 */
+		void record(uint64_t micros, bool timedOut);
+
+		const char *getName() const {
+			return name;
+		}
+
+		/**
+		 * Prints the histogram of every site which has waited
+		 */
+		static void dumpAll();
+};
+
+/**
+ * Waits until the predicate returns true or the deadline is reached
+ * @param site the call site to record the wait in
+ * @param predicate the condition to wait for
+ * @param deadline when to give up
+ * @param policy how to back off between checks
+ * @return false if the deadline was reached
+ */
+template <typename Predicate>
+bool waitUntil(WaitSite &site, Predicate &&predicate, Deadline deadline=Deadline::never(), BackoffPolicy policy=BackoffPolicy::fast()) {
+	if (predicate()) [[likely]] {
+		site.record(0, false);
+		return true;
+	}
+
+	const uint64_t start = getMicroseconds();
+	uint32_t spins = 0;
+	uint32_t yields = 0;
+	uint32_t sleep = policy.minSleep;
+	while (true) {
+		if (spins < policy.spins) {
+			spins++;
+			__builtin_ia32_pause();
+		} else if (yields < policy.yields) {
+			yields++;
+			waitYield();
+		} else if (policy.maxSleep != 0) {
+			waitSleep(sleep);
+			sleep = sleep * 2 < policy.maxSleep ? sleep * 2 : policy.maxSleep;
+		}
+
+		if (predicate()) {
+			site.record(getMicroseconds() - start, false);
+			return true;
+		}
+
+		// reading the clock costs more than a pause
+		if (!deadline.isNever() && (spins >= policy.spins || (spins & 0xff) == 0)) {
+			const uint64_t now = getMicroseconds();
+			if (deadline.expired(now)) [[unlikely]] {
+				site.record(now - start, true);
+				__builtin_printf("wait for %s timed out after %llu us\n", site.getName(), (unsigned long long) (now - start));
+				return false;
+			}
+		}
+	}
+}
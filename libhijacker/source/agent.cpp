@@ -0,0 +1,219 @@
+#include "hijacker.hpp"
+#include "hijacker/agent.hpp"
+#include "util.hpp"
+#include "wait.hpp"
+
+extern "C" {
+	#include <stddef.h>
+	#include <stdint.h>
+	#include <stdio.h>
+}
+
+// the liveness check is an mdbg call so only do it between longer waits
+static constexpr uint64_t LIVENESS_INTERVAL = 100000;
+
+// a main thread blocked in a syscall never reaches the agent
+static constexpr uint64_t START_TIMEOUT = 3000000;
+
+// longer than any single call the loader makes
+static constexpr uint64_t COMMAND_TIMEOUT = 10000000;
+
+static constinit WaitSite startWait{"Agent::create"};
+static constinit WaitSite commandWait{"Agent::wait"};
+
+namespace {
+
+extern uint8_t AGENT_SHELLCODE[300];
+
+}
+
+namespace nid {
+
+static inline constexpr Nid usleep{"QcteRwbsnV0"};
+static inline constexpr Nid errno{"9BcDykPmo1I"};
+
+}
+
+Agent::Agent(Hijacker *hijacker, AgentQueue *queue, TrapFrame *backup) :
+	hijacker(hijacker), queue(queue), backup(backup), head(), running(true) {}
+
+UniquePtr<Agent> Agent::create(Hijacker &hijacker) {
+	Mailbox *mailbox = hijacker.getMailbox();
+	if (mailbox == nullptr) [[unlikely]] {
+		return nullptr;
+	}
+
+	// the queue must outlive any scratch allocations
+	const uintptr_t addr = mailbox->reserve(sizeof(AgentQueue));
+	if (addr == 0) [[unlikely]] {
+		puts("not enough space in the mailbox for the agent queue");
+		return nullptr;
+	}
+
+	auto *queue = static_cast<AgentQueue *>(mailbox->toLocal(addr));
+	queue->head = 0;
+	queue->tail = 0;
+	queue->started = 0;
+	queue->usleep = hijacker.getLibKernelFunctionAddress(nid::usleep);
+	queue->error = hijacker.getLibKernelFunctionAddress(nid::errno);
+
+	const uintptr_t entry = hijacker.loadCode(AGENT_SHELLCODE);
+	if (entry == 0) [[unlikely]] {
+		return nullptr;
+	}
+
+	// kept so the thread can be returned if the agent is never started
+	UniquePtr<TrapFrame> backup = nullptr;
+	{
+		ScopedSuspender suspender{&hijacker};
+		auto frame = hijacker.getTrapFrame();
+		if (frame == nullptr) [[unlikely]] {
+			return nullptr;
+		}
+
+		backup = new TrapFrame(*frame.get());
+
+		// leave the interrupted function's red zone alone and align the
+		// stack as if the agent had been called
+		const uintptr_t rsp = ((frame->getRsp() - 0x100) & ~0xfULL) - 8;
+
+		frame->setRdi(addr)
+			.setRip(entry)
+			.setRsp(rsp)
+			.flush();
+	}
+
+	const bool started = waitUntil(startWait, [queue]() {
+		return __atomic_load_n(&queue->started, __ATOMIC_ACQUIRE) != 0;
+	}, Deadline::after(START_TIMEOUT), BackoffPolicy::fast());
+
+	if (!started) [[unlikely]] {
+		ScopedSuspender suspender{&hijacker};
+		// it may have got there while we were suspending it
+		if (__atomic_load_n(&queue->started, __ATOMIC_ACQUIRE) == 0) {
+			puts("the main thread never entered the agent");
+			auto frame = hijacker.getTrapFrame();
+			if (frame != nullptr) [[likely]] {
+				frame->setFrame(backup.get()).flush();
+			}
+			return nullptr;
+		}
+	}
+
+	return new Agent(&hijacker, queue, backup.release());
+}
+
+Agent::~Agent() {
+	if (!running || !flush()) {
+		return;
+	}
+	ScopedSuspender suspender{hijacker};
+	hijacker->getTrapFrame()->setFrame(backup.get())
+		.flush();
+}
+
+AgentCommand &Agent::next() {
+	// wait for the slot to be free
+	if (head >= AgentQueue::NUM_SLOTS) {
+		wait(head - AgentQueue::NUM_SLOTS);
+	}
+	return queue->commands[head % AgentQueue::NUM_SLOTS];
+}
+
+uint32_t Agent::submit() {
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+	return head++;
+}
+
+uint32_t Agent::call(const RemoteCall &call) {
+	AgentCommand &cmd = next();
+	cmd.op = AgentCommand::CALL;
+	cmd.err = 0;
+	cmd.result = 0;
+	cmd.fn = call.fn;
+	__builtin_memcpy(cmd.args, call.args, sizeof(cmd.args));
+	return submit();
+}
+
+uint32_t Agent::copy(uintptr_t dst, uintptr_t src, size_t length) {
+	AgentCommand &cmd = next();
+	cmd = {AgentCommand::COPY, 0, 0, 0, {dst, src, length}};
+	return submit();
+}
+
+void Agent::start(uintptr_t entry, uintptr_t rsp, uintptr_t arg) {
+	AgentCommand &cmd = next();
+	cmd = {AgentCommand::START, 0, 0, entry, {rsp, arg}};
+	submit();
+	running = false;
+}
+
+bool Agent::wait(uint32_t ticket) {
+	const uint32_t target = ticket + 1;
+	uint64_t nextCheck = 0;
+	uint32_t polls = 0;
+	bool alive = true;
+	const bool finished = waitUntil(commandWait, [&]() {
+		if ((int32_t)(__atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) - target) >= 0) [[likely]] {
+			return true;
+		}
+		// reading the clock costs more than a pause
+		if ((++polls & 0xff) != 0) {
+			return false;
+		}
+		const uint64_t now = getMicroseconds();
+		if (nextCheck == 0) {
+			nextCheck = now + LIVENESS_INTERVAL;
+		} else if (now >= nextCheck) [[unlikely]] {
+			nextCheck = now + LIVENESS_INTERVAL;
+			alive = hijacker->isAlive();
+		}
+		return !alive;
+	}, Deadline::after(COMMAND_TIMEOUT), BackoffPolicy::fast());
+
+	if (!alive) [[unlikely]] {
+		puts("process died while waiting for the agent");
+		running = false;
+		return false;
+	}
+
+	if (!finished) [[unlikely]] {
+		// give up on the agent and return the thread to where it was interrupted
+		printf("the agent did not finish command %u in time\n", ticket);
+		running = false;
+		ScopedSuspender suspender{hijacker};
+		auto frame = hijacker->getTrapFrame();
+		if (frame != nullptr) [[likely]] {
+			frame->setFrame(backup.get()).flush();
+		}
+		return false;
+	}
+	return true;
+}
+
+namespace {
+
+// see shellcode/agent.cpp for source
+uint8_t AGENT_SHELLCODE[]{
+	0x41, 0x56, 0x41, 0x55, 0x41, 0x54, 0x4c, 0x8d, 0x6f, 0x20, 0x55, 0x53, 0x49, 0x89, 0xfc, 0x45,
+	0x31, 0xf6, 0x8b, 0x6f, 0x04, 0xc7, 0x47, 0x08, 0x01, 0x00, 0x00, 0x00, 0x0f, 0x1f, 0x40, 0x00,
+	0x89, 0xeb, 0x41, 0x8b, 0x04, 0x24, 0x83, 0xe3, 0x1f, 0x48, 0x6b, 0xdb, 0x78, 0x4c, 0x01, 0xeb,
+	0x39, 0xe8, 0x74, 0x3c, 0x8b, 0x03, 0x83, 0xf8, 0x01, 0x0f, 0x84, 0xc1, 0x00, 0x00, 0x00, 0x83,
+	0xf8, 0x02, 0x0f, 0x84, 0x98, 0x00, 0x00, 0x00, 0x85, 0xc0, 0x74, 0x44, 0x48, 0xc7, 0x43, 0x08,
+	0xff, 0xff, 0xff, 0xff, 0xb8, 0x16, 0x00, 0x00, 0x00, 0x89, 0x43, 0x04, 0xff, 0xc5, 0x45, 0x31,
+	0xf6, 0x41, 0x89, 0x6c, 0x24, 0x04, 0xeb, 0xb8, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x41, 0x81, 0xfe, 0xff, 0xff, 0x00, 0x00, 0x0f, 0x87, 0xa0, 0x00, 0x00, 0x00, 0xf3, 0x90, 0x41,
+	0xff, 0xc6, 0xeb, 0x9c, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x90,
+	0x41, 0xff, 0x54, 0x24, 0x18, 0x48, 0x8b, 0x4b, 0x30, 0x48, 0x8b, 0x53, 0x28, 0x48, 0x8b, 0x73,
+	0x20, 0xc7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x8b, 0x7b, 0x18, 0xff, 0x73, 0x70, 0xff, 0x73,
+	0x68, 0xff, 0x73, 0x60, 0xff, 0x73, 0x58, 0xff, 0x73, 0x50, 0xff, 0x73, 0x48, 0x4c, 0x8b, 0x4b,
+	0x40, 0x4c, 0x8b, 0x43, 0x38, 0xff, 0x53, 0x10, 0x48, 0x89, 0x43, 0x08, 0x48, 0x83, 0xc4, 0x30,
+	0x41, 0xff, 0x54, 0x24, 0x18, 0x8b, 0x00, 0xe9, 0x7d, 0xff, 0xff, 0xff, 0x0f, 0x1f, 0x40, 0x00,
+	0x48, 0x8b, 0x43, 0x18, 0x48, 0x8b, 0x7b, 0x20, 0x48, 0x8b, 0x53, 0x10, 0x48, 0x89, 0xc4, 0x31,
+	0xed, 0xff, 0xe2, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x90,
+	0x48, 0x8b, 0x7b, 0x18, 0x48, 0x8b, 0x73, 0x20, 0x48, 0x8b, 0x4b, 0x28, 0xf3, 0xa4, 0x31, 0xc0,
+	0x48, 0xc7, 0x43, 0x08, 0x00, 0x00, 0x00, 0x00, 0xe9, 0x3c, 0xff, 0xff, 0xff, 0xbf, 0x32, 0x00,
+	0x00, 0x00, 0x41, 0xff, 0x54, 0x24, 0x10, 0xe9, 0xf4, 0xfe, 0xff, 0xff
+};
+
+} // anonymous namespace
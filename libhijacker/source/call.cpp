@@ -0,0 +1,132 @@
+#include "hijacker.hpp"
+#include "hijacker/call.hpp"
+#include "util.hpp"
+
+extern "C" {
+	#include <stddef.h>
+	#include <stdint.h>
+	#include <stdio.h>
+}
+
+namespace {
+
+extern uint8_t TRAMPOLINE_SHELLCODE[138];
+
+}
+
+namespace nid {
+
+static inline constexpr Nid usleep{"QcteRwbsnV0"};
+static inline constexpr Nid errno{"9BcDykPmo1I"};
+
+}
+
+struct TrampolineArgs {
+	struct Result {
+		int32_t state;
+		int32_t err;
+	} result;
+	uintptr_t usleep;
+	uintptr_t errno;
+	uint64_t numCalls;
+
+	TrampolineArgs(Hijacker &hijacker, size_t numCalls) : result({0, 0}), numCalls(numCalls) {
+		usleep = hijacker.getLibKernelFunctionAddress(nid::usleep);
+		errno = hijacker.getLibKernelFunctionAddress(nid::errno);
+	}
+};
+
+bool CallBatch::execute() {
+	if (count == 0) [[unlikely]] {
+		return true;
+	}
+
+	if (Agent *agent = hijacker->getRunningAgent()) {
+		// the agent is already servicing the main thread so no hijack is needed
+		// the batch fits in the queue so none of the results are overwritten
+		const uint32_t first = agent->call(calls[0]);
+		for (size_t i = 1; i < count; i++) {
+			agent->call(calls[i]);
+		}
+		if (!agent->flush()) [[unlikely]] {
+			return false;
+		}
+		for (size_t i = 0; i < count; i++) {
+			calls[i].result = agent->result(first + i);
+			calls[i].err = agent->error(first + i);
+		}
+		return true;
+	}
+
+	uintptr_t &entry = hijacker->trampoline;
+	if (entry == 0) [[unlikely]] {
+		// the trampoline is reused for every call
+		entry = hijacker->loadCode(TRAMPOLINE_SHELLCODE);
+		if (entry == 0) [[unlikely]] {
+			return false;
+		}
+	}
+
+	TrampolineArgs args{*hijacker, count};
+	ScopedScratch scratch{hijacker};
+	const uintptr_t argbuf = hijacker->allocateScratch(sizeof(args) + sizeof(RemoteCall) * count);
+	if (argbuf == 0) [[unlikely]] {
+		puts("no scratch memory for the calls");
+		return false;
+	}
+	const uintptr_t callbuf = argbuf + sizeof(args);
+	hijacker->write(argbuf, &args, sizeof(args));
+	hijacker->write(callbuf, calls, sizeof(RemoteCall) * count);
+
+	{
+		ScopedSuspender suspender{hijacker};
+		auto frame = hijacker->getTrapFrame();
+		if (frame == nullptr) [[unlikely]] {
+			return false;
+		}
+
+		// the process must continue where it left off once the calls are done
+		UniquePtr<TrapFrame> backup{new TrapFrame(*frame.get())};
+
+		// leave the interrupted function's red zone alone and align the
+		// stack as if the trampoline had been called
+		const uintptr_t rsp = ((frame->getRsp() - 0x100) & ~0xfULL) - 8;
+
+		frame->setRdi(argbuf)
+			.setRip(entry)
+			.setRsp(rsp)
+			.flush();
+
+		hijacker->resume();
+
+		int32_t state = 0;
+		if (!hijacker->waitForState(argbuf, state)) [[unlikely]] {
+			printf("process died while calling 0x%08llx\n", (unsigned long long) calls[0].fn);
+			return false;
+		}
+
+		hijacker->suspend();
+		hijacker->getTrapFrame()->setFrame(backup.get())
+			.flush();
+	}
+
+	hijacker->read(callbuf, calls, sizeof(RemoteCall) * count);
+	return true;
+}
+
+namespace {
+
+// see shellcode/trampoline.cpp for source
+uint8_t TRAMPOLINE_SHELLCODE[]{
+	0x41, 0x54, 0x45, 0x31, 0xe4, 0x55, 0x53, 0x48, 0x83, 0x7f, 0x18, 0x00, 0x48, 0x89, 0xfd, 0x48,
+	0x8d, 0x5f, 0x20, 0x74, 0x5d, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0x55, 0x10, 0x4c, 0x8b, 0x4b, 0x30, 0x49, 0xff, 0xc4, 0x4c, 0x8b, 0x43, 0x28, 0x48, 0x8b,
+	0x4b, 0x20, 0xc7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x8b, 0x53, 0x18, 0x48, 0x8b, 0x73, 0x10,
+	0x48, 0x8b, 0x7b, 0x08, 0xff, 0x73, 0x60, 0xff, 0x73, 0x58, 0xff, 0x73, 0x50, 0xff, 0x73, 0x48,
+	0xff, 0x73, 0x40, 0xff, 0x73, 0x38, 0xff, 0x13, 0x48, 0x83, 0xc3, 0x78, 0x48, 0x89, 0x43, 0xf0,
+	0x48, 0x83, 0xc4, 0x30, 0xff, 0x55, 0x10, 0x8b, 0x00, 0x89, 0x43, 0xf8, 0x4c, 0x3b, 0x65, 0x18,
+	0x72, 0xae, 0xc7, 0x45, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00,
+	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0x55, 0x08, 0xeb, 0xf6
+};
+
+} // anonymous namespace
@@ -0,0 +1,84 @@
+#include "hijacker.hpp"
+#include "hijacker/codecache.hpp"
+#include "util.hpp"
+
+extern "C" {
+	#include <stdint.h>
+	#include <stdio.h>
+}
+
+static constexpr size_t REGISTRY_LENGTH = (sizeof(CodeCacheRegistry) + 0xf) & ~0xf;
+
+bool CodeCache::load() {
+	ProcessMemoryAllocator &allocator = hijacker->textAllocator;
+	if (allocator.getAllocated() != 0) [[unlikely]] {
+		// the registry must be the first thing allocated from the section
+		#ifdef DEBUG
+		fatalf("text was allocated outside of the code cache\n");
+		#endif
+		return false;
+	}
+
+	address = hijacker->getEboot()->getTextSection()->end() - REGISTRY_LENGTH;
+	hijacker->read(address, &registry, sizeof(registry));
+
+	const bool valid = registry.magic == CodeCacheRegistry::MAGIC &&
+		registry.count <= CodeCacheRegistry::MAX_ENTRIES &&
+		registry.used >= REGISTRY_LENGTH &&
+		registry.used <= ProcessMemoryAllocator::MAX_ALLOCATED;
+
+	if (valid) {
+		// keep everything already resident
+		allocator.setAllocated(registry.used);
+		return true;
+	}
+
+	if (allocator.allocate(REGISTRY_LENGTH) != address) [[unlikely]] {
+		return false;
+	}
+	registry = {CodeCacheRegistry::MAGIC, 0, (uint32_t) allocator.getAllocated(), {}};
+	return hijacker->write(address, &registry, sizeof(registry));
+}
+
+uintptr_t CodeCache::get(const uint8_t *code, size_t length) {
+	ProcessMemoryAllocator &allocator = hijacker->textAllocator;
+	if (!loaded) [[unlikely]] {
+		loaded = true;
+		if (!load()) [[unlikely]] {
+			address = 0;
+		}
+	}
+
+	if (address == 0) [[unlikely]] {
+		// no registry, so every blob is uploaded
+		const uintptr_t addr = allocator.allocate(length);
+		if (addr != 0) [[likely]] {
+			hijacker->write(addr, code, length);
+		}
+		return addr;
+	}
+
+	const uintptr_t end = address + REGISTRY_LENGTH;
+	const uint64_t h = hash(code, length);
+	for (uint32_t i = 0; i < registry.count; i++) {
+		const auto &entry = registry.entries[i];
+		if (entry.hash == h && entry.length == length) {
+			return end - entry.offset;
+		}
+	}
+
+	const uintptr_t addr = allocator.allocate(length);
+	if (addr == 0) [[unlikely]] {
+		return 0;
+	}
+	hijacker->write(addr, code, length);
+
+	registry.used = (uint32_t) allocator.getAllocated();
+	if (registry.count < CodeCacheRegistry::MAX_ENTRIES) [[likely]] {
+		registry.entries[registry.count++] = {h, (uint32_t) (end - addr), (uint32_t) length};
+	}
+
+	// the code must be written before the registry refers to it
+	hijacker->write(address, &registry, sizeof(registry));
+	return addr;
+}
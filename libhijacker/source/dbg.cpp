@@ -59,24 +59,44 @@ static uintptr_t getCurrentProc() {
 
 namespace dbg {
 
-class DbgAuthidSwapper {
+static constexpr int AUTHID_OFFSET = 0x58;
 
-	uint64_t id;
-	static constexpr int AUTHID_OFFSET = 0x58;
+// shared by every Session in the process since the authid belongs to our ucred
+static struct {
+	uintptr_t ucred;
+	uint64_t authid;
+	int depth;
+	int lock;
+} sessionState{};
 
-public:
-	DbgAuthidSwapper(uint64_t authid) {
-		uintptr_t proc = getCurrentProc();
-		uintptr_t ucred = kread<uintptr_t>(proc + UCRED_OFFSET);
-		id = kread<uint64_t>(ucred + AUTHID_OFFSET);
-		kwrite(ucred + AUTHID_OFFSET, authid);
+static void lockSession() {
+	while (__atomic_exchange_n(&sessionState.lock, 1, __ATOMIC_ACQUIRE)) {
+		__builtin_ia32_pause();
 	}
-	~DbgAuthidSwapper() {
+}
+
+static void unlockSession() {
+	__atomic_store_n(&sessionState.lock, 0, __ATOMIC_RELEASE);
+}
+
+Session::Session() {
+	lockSession();
+	if (sessionState.depth++ == 0) {
 		uintptr_t proc = getCurrentProc();
-		uintptr_t ucred = kread<uintptr_t>(proc + UCRED_OFFSET);
-		kwrite(ucred + AUTHID_OFFSET, id);
+		sessionState.ucred = kread<uintptr_t>(proc + UCRED_OFFSET);
+		sessionState.authid = kread<uint64_t>(sessionState.ucred + AUTHID_OFFSET);
+		kwrite(sessionState.ucred + AUTHID_OFFSET, DEBUGGER_AUTHID);
 	}
-};
+	unlockSession();
+}
+
+Session::~Session() {
+	lockSession();
+	if (--sessionState.depth == 0) {
+		kwrite(sessionState.ucred + AUTHID_OFFSET, sessionState.authid);
+	}
+	unlockSession();
+}
 
 int __attribute__((noinline)) mdbg_call(DbgArg1 &arg1, DbgArg2 &arg2, DbgArg3 &arg3) {
 
@@ -91,7 +111,8 @@ int __attribute__((noinline)) mdbg_call(DbgArg1 &arg1, DbgArg2 &arg2, DbgArg3 &a
 	}
 
 	if (_mdbg) [[likely]] {
-		DbgAuthidSwapper swapper{DEBUGGER_AUTHID};
+		// only the outermost session touches the ucred
+		Session session{};
 		return syscall_mdbg_call(&arg1, &arg2, &arg3);
 	}
 	puts("_mdbg is null");
@@ -148,17 +169,115 @@ void resume(int pid) {
 	mdbg_call(arg1, arg2, arg3);
 }
 
-void read(int pid, uintptr_t src, void *dst, size_t length) {
+static int readRaw(int pid, uintptr_t src, void *dst, size_t length) {
 	DbgArg1 arg1{1, DbgCommand::READ_CMD};
 	DbgReadArg arg2{pid, src, dst, length};
 	DbgArg3 arg3{};
 	mdbg_call(arg1, arg2, arg3);
 	if (arg3.length != length) {
 		int err = arg3.err != -1 ? (int) arg3.err : errno;
+		// make sure a failure is never reported as success
+		return err != 0 ? err : EFAULT;
+	}
+	return 0;
+}
+
+void read(int pid, uintptr_t src, void *dst, size_t length) {
+	int err = readRaw(pid, src, dst, length);
+	if (err != 0) {
 		printf("read failed %d: %s\n", err, strerror(err));
 	}
 }
 
+size_t readv(int pid, const ReadOp *ops, size_t n, int *errors) {
+	if (n == 0) [[unlikely]] {
+		return 0;
+	}
+
+	// sort the op indices by source address, n is always small
+	UniquePtr<size_t[]> order{new size_t[n]};
+	for (size_t i = 0; i < n; i++) {
+		size_t j = i;
+		while (j > 0 && ops[order[j - 1]].src > ops[i].src) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	Session session{};
+	size_t failed = 0;
+	size_t i = 0;
+	while (i < n) {
+		const ReadOp &first = ops[order[i]];
+		const uintptr_t start = first.src;
+		uintptr_t end = start + first.length;
+		size_t j = i + 1;
+		// fuse every following op which overlaps or touches the current range
+		while (j < n && ops[order[j]].src <= end) {
+			const ReadOp &op = ops[order[j]];
+			if (op.src + op.length > end) {
+				end = op.src + op.length;
+			}
+			j++;
+		}
+
+		int err = 0;
+		if (j - i == 1) {
+			err = readRaw(pid, start, first.dst, first.length);
+		} else {
+			UniquePtr<uint8_t[]> buf{new uint8_t[end - start]};
+			err = readRaw(pid, start, buf.get(), end - start);
+			if (err == 0) [[likely]] {
+				for (size_t k = i; k < j; k++) {
+					const ReadOp &op = ops[order[k]];
+					__builtin_memcpy(op.dst, buf.get() + (op.src - start), op.length);
+				}
+			}
+		}
+
+		for (size_t k = i; k < j; k++) {
+			const size_t index = order[k];
+			const ReadOp &op = ops[index];
+			int res = err;
+			if (err != 0 && j - i > 1) {
+				// the fused read failed, retry individually to find the bad op
+				res = readRaw(pid, op.src, op.dst, op.length);
+			}
+			if (res != 0) {
+				__builtin_memset(op.dst, 0, op.length);
+				failed++;
+			}
+			if (errors != nullptr) {
+				errors[index] = res;
+			}
+		}
+		i = j;
+	}
+	return failed;
+}
+
+void readPages(int pid, uintptr_t base, uintptr_t addr, uint8_t *dst, size_t length, PageBitmap &valid) {
+	const size_t first = (addr - base) / RANGE_PAGE_SIZE;
+	const size_t last = (addr + length - 1 - base) / RANGE_PAGE_SIZE;
+	if (readRaw(pid, addr, dst, length) == 0) [[likely]] {
+		for (size_t i = first; i <= last; i++) {
+			valid.set(i);
+		}
+		return;
+	}
+	if (first == last) {
+		// unmapped or protected, nothing smaller is worth trying
+		__builtin_memset(dst, 0, length);
+		return;
+	}
+	// split on the page boundary closest to the middle so that both halves are retried
+	const uintptr_t middle = base + (first + (last - first + 1) / 2) * RANGE_PAGE_SIZE;
+	const size_t head = middle - addr;
+	readPages(pid, base, addr, dst, head, valid);
+	readPages(pid, base, middle, dst + head, length - head, valid);
+}
+
 bool write(int pid, uintptr_t dst, const void *src, size_t length) {
 	DbgArg1 arg1{1, DbgCommand::WRITE_CMD};
 	DbgReadArg arg2{pid, dst, const_cast<void *>(src), length};
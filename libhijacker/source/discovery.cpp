@@ -0,0 +1,95 @@
+#include "kernel/discovery.hpp"
+
+extern "C" {
+	#include <fcntl.h>
+	#include <stdint.h>
+	#include <stdio.h>
+	#include <unistd.h>
+	ssize_t _read(int, void *, size_t);
+	ssize_t _write(int, const void *, size_t);
+}
+
+static constexpr const char *CACHE_PATH = "/data/hijacker_offsets.bin";
+
+namespace {
+
+struct CacheEntry {
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t allproc;
+	uint64_t root_vnode;
+};
+
+struct Cache {
+	static constexpr uint64_t MAGIC = 0x3146464f4b434a48; // HJCKOFF1
+	static constexpr size_t MAX_ENTRIES = 8;
+
+	uint64_t magic;
+	uint64_t count;
+	CacheEntry entries[MAX_ENTRIES];
+};
+
+bool readCache(Cache &cache) {
+	const int fd = open(CACHE_PATH, O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+	const ssize_t n = _read(fd, &cache, sizeof(cache));
+	close(fd);
+	return n == sizeof(cache) && cache.magic == Cache::MAGIC && cache.count <= Cache::MAX_ENTRIES;
+}
+
+} // anonymous namespace
+
+namespace discovery {
+
+bool load(uint32_t version, layout::KernelLayout &result) {
+	Cache cache;
+	if (!readCache(cache)) {
+		return false;
+	}
+	for (size_t i = 0; i < cache.count; i++) {
+		const CacheEntry &entry = cache.entries[i];
+		if (entry.version == (version & 0xffff0000)) {
+			result = layout::UNSUPPORTED;
+			result.version = entry.version;
+			result.allproc = entry.allproc;
+			result.root_vnode = entry.root_vnode;
+			return true;
+		}
+	}
+	return false;
+}
+
+void save(const layout::KernelLayout &result) {
+	Cache cache;
+	if (!readCache(cache)) {
+		cache = {Cache::MAGIC, 0, {}};
+	}
+
+	size_t i = 0;
+	while (i < cache.count && cache.entries[i].version != result.version) {
+		i++;
+	}
+	if (i == Cache::MAX_ENTRIES) {
+		// drop the oldest, a loop since memmove is not linked into the payloads
+		for (size_t j = 1; j < Cache::MAX_ENTRIES; j++) {
+			cache.entries[j - 1] = cache.entries[j];
+		}
+		i--;
+	}
+	cache.entries[i] = {result.version, 0, result.allproc, result.root_vnode};
+	cache.count = i < cache.count ? cache.count : i + 1;
+
+	const int fd = open(CACHE_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		puts("failed to open the kernel offset cache");
+		return;
+	}
+	if (_write(fd, &cache, sizeof(cache)) != sizeof(cache)) {
+		puts("failed to write the kernel offset cache");
+	}
+	close(fd);
+}
+
+} // discovery
@@ -2,8 +2,10 @@
 #include "kernel/proc.hpp"
 #include "kernel/rtld.hpp"
 #include "util.hpp"
+#include "wait.hpp"
 #include <ps5/kernel.h>
 #include <sys/elf_common.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 extern "C" {
@@ -14,15 +16,23 @@ extern "C" {
 	#include <ps5/payload_main.h>
 	int puts(const char *);
 	int usleep(unsigned int useconds);
+	void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset);
+	int munmap(void *addr, size_t len);
+	int shm_open(const char *path, int flags, mode_t mode);
 	extern int _master_sock;
 	extern int _victim_sock;
 }
 
+#ifndef SHM_ANON
+#define SHM_ANON ((char *)1)
+#endif
+
 namespace {
 
-extern uint8_t LIBLOADER_SHELLCODE[153];
-extern uint8_t ALLOCATOR_SHELLCODE[729];
-extern uint8_t KERNELRW_SHELLCODE[278];
+extern uint8_t LIBLOADER_SHELLCODE[123];
+extern uint8_t ALLOCATOR_SHELLCODE[1028];
+extern uint8_t KERNELRW_SHELLCODE[269];
+extern uint8_t RESOLVER_SHELLCODE[201];
 };
 
 constexpr size_t PAGE_SIZE = 0x4000;
@@ -30,15 +40,17 @@ constexpr size_t PAGE_SIZE = 0x4000;
 namespace nid {
 
 static inline constexpr Nid sceSysmoduleLoadModuleByNameInternal{"CU8m+Qs+HN4"};
-static inline constexpr Nid usleep{"QcteRwbsnV0"};
 static inline constexpr Nid errno{"9BcDykPmo1I"};
 static inline constexpr Nid mmap{"BPE9s9vQQXo"};
 static inline constexpr Nid munmap{"UqDGjXA5yUM"};
 static inline constexpr Nid sceKernelJitCreateSharedMemory{"avvJ3J0H0EY"};
+static inline constexpr Nid sceKernelJitCreateAliasOfSharedMemory{"MR221Mwo0Pc"};
+static inline constexpr Nid close{"bY-PO6JhzhQ"};
 static inline constexpr Nid socket{"TU-d9PfIHPM"};
 static inline constexpr Nid pipe{"-Jp7F+pXxNg"};
 static inline constexpr Nid sceKernelDlsym{"LwG8g3niqwA"};
 static inline constexpr Nid setsockopt{"fFxGkxF2bVo"};
+static inline constexpr Nid pthread_create{"OxhIB8LB-PQ"};
 
 }
 
@@ -177,13 +189,20 @@ Elf::Elf(Hijacker *hijacker, uint8_t *data) :
 		Elf64_Ehdr(*(Elf64_Ehdr *)data), phdrs((Elf64_Phdr*)(data + e_phoff)),
 		strtab(), strtabLength(), symtab(), symtabLength(), relatbl(), relaLength(),
 		plt(), pltLength(), hijacker(hijacker), textOffset(), imagebase(),
-		data(data), libs(nullptr) {
+		data(data), libs(nullptr), imports(nullptr), numImports(), resolveInTarget(true), verifyImports(),
+		segments(nullptr), sharedText(), sharedTextLength(), sharedData(), sharedDataLength() {
 	// TODO check the elf magic stupid
 	//hexdump(data, sizeof(Elf64_Ehdr));
 }
 
 Elf::~Elf() {
 	// this is to ensure that the destructor for SymbolLookupTable is visible
+	if (sharedText != nullptr) {
+		munmap(sharedText, sharedTextLength);
+	}
+	if (sharedData != nullptr) {
+		munmap(sharedData, sharedDataLength);
+	}
 }
 
 bool loadLibraries(Hijacker &hijacker, const List<String> &paths, Array<SymbolLookupTable> &libs, const size_t reserved);
@@ -335,8 +354,7 @@ bool Elf::parseDynamicTable() {
 	}
 
 	for (auto i = 0; i < handleCount; i++) {
-		SymbolLookupTable &lib = libs[i] = hijacker->getLib(preLoadedHandles[i]).release();
-		lib.fillTable();
+		libs[i] = hijacker->getLib(preLoadedHandles[i]).release();
 	}
 
 	return true;
@@ -348,7 +366,6 @@ struct LibLoaderArgs {
 		int32_t err;
 	} result;
 	uintptr_t sceSysmoduleLoadModuleByNameInternal;
-	uintptr_t usleep;
 	uintptr_t strtab;
 	uintptr_t offsets;
 	int numOffsets;
@@ -357,9 +374,8 @@ struct LibLoaderArgs {
 		UniquePtr<SharedLib> libSceSystemService = hijacker.getLib(0x11);
 		sceSysmoduleLoadModuleByNameInternal =
 			hijacker.getFunctionAddress(libSceSystemService.get(), nid::sceSysmoduleLoadModuleByNameInternal);
-		usleep = hijacker.getLibKernelFunctionAddress(nid::usleep);
-		strtab = hijacker.getDataAllocator().allocate(fulltbl.length());
-		offsets = hijacker.getDataAllocator().allocate(sizeof(uintptr_t) * nlibs);
+		strtab = hijacker.allocateScratch(fulltbl.length());
+		offsets = hijacker.allocateScratch(sizeof(uintptr_t) * nlibs);
 		numOffsets = nlibs;
 	}
 };
@@ -383,40 +399,37 @@ bool loadLibraries(Hijacker &hijacker, const List<String> &names, Array<SymbolLo
 		}
 	}
 	LibLoaderArgs args{hijacker, fulltbl, (int) nlibs};
-	auto argbuf = hijacker.getDataAllocator().allocate(sizeof(args));
+	ScopedScratch scratch{&hijacker};
+	auto argbuf = hijacker.allocateScratch(sizeof(args));
+	if (argbuf == 0 || args.strtab == 0 || args.offsets == 0) [[unlikely]] {
+		puts("no scratch memory for the libloader shellcode");
+		return false;
+	}
 	hijacker.write(argbuf, &args, sizeof(args));
 	hijacker.write(args.offsets, positions.get(), positionsSize);
 	hijacker.write(args.strtab, fulltbl.c_str(), fulltbl.length());
 
-	ProcessPointer<LibLoaderArgs::Result> res = hijacker.getPointer<LibLoaderArgs::Result>(argbuf);
-
 	// invoke shellcode to load the libraries
-	uintptr_t entry = hijacker.getTextAllocator().allocate(sizeof(LIBLOADER_SHELLCODE));
-	hijacker.write(entry, LIBLOADER_SHELLCODE);
-	{
-		ScopedSuspender suspender{&hijacker};
-		auto frame = hijacker.getTrapFrame();
-		frame->setRdi(argbuf)
-			.setRip(entry)
-			.flush();
-
-		hijacker.resume();
-		LibLoaderArgs::Result state{0, 0};
-		do {
-			usleep(10);
-			state = *res;
-		} while (state.state == 0);
-
-		if (state.state != 1) [[unlikely]] {
-			printf("failed to load lib %s 0x%08llx\n", names[state.err].c_str(), positions[state.err]);;
-			return false;
-		}
-		hijacker.read(args.offsets, positions.get(), positionsSize);
+	uintptr_t entry = hijacker.loadCode(LIBLOADER_SHELLCODE);
+	if (entry == 0) [[unlikely]] {
+		puts("no space for the libloader shellcode");
+		return false;
+	}
+	hijacker.call<void>(entry, argbuf);
+	if (hijacker.getLastCallError() == -1) [[unlikely]] {
+		puts("process died while loading libraries");
+		return false;
+	}
+
+	const auto res = hijacker.read<LibLoaderArgs::Result>(argbuf);
+	if (res.state != 1) [[unlikely]] {
+		printf("failed to load lib %s 0x%08llx\n", names[res.err].c_str(), positions[res.err]);
+		return false;
 	}
+	hijacker.read(args.offsets, positions.get(), positionsSize);
 
 	for (size_t i = 0; i < nlibs; i++) {
-		SymbolLookupTable &lib = libs[i + reserved] = hijacker.getLib(positions[i]).release();
-		lib.fillTable();
+		libs[i + reserved] = hijacker.getLib(positions[i]).release();
 	}
 
 	return true;
@@ -430,6 +443,9 @@ static constexpr uint32_t PROT_READ = 1;
 static constexpr uint32_t PROT_WRITE = 2;
 static constexpr uint32_t PROT_EXEC = 4;
 
+static constexpr int MAP_SHARED = 1;
+static void *const MAP_FAILED = (void *) -1;
+
 static inline uint32_t toMmapProt(const Elf64_Phdr *__restrict phdr) {
 	uint32_t res = 0;
 	if (phdr->p_flags & PF_X) [[unlikely]] {
@@ -449,6 +465,7 @@ struct AllocationInfo {
 	uint64_t length;
 	uintptr_t result;
 	uint32_t protection;
+	uint64_t offset;
 };
 
 struct AllocatorArgs {
@@ -456,83 +473,121 @@ struct AllocatorArgs {
 		int32_t state;
 		int32_t err;
 	} result;
-	uintptr_t usleep;
 	uintptr_t mmap;
 	uintptr_t munmap;
+	uintptr_t close;
 	uintptr_t sceKernelJitCreateSharedMemory;
+	uintptr_t sceKernelJitCreateAliasOfSharedMemory;
 	uintptr_t errno;
 	uintptr_t info;
+	uintptr_t address;
 	int numInfo;
+	int dataFd;
+	int aliasFd;
 
-	AllocatorArgs(Hijacker& hijacker, int infoCount) : result({0, 0}) {
-		usleep = hijacker.getLibKernelFunctionAddress(nid::usleep);
+	AllocatorArgs(Hijacker& hijacker, int infoCount, uintptr_t address, int dataFd) : result({0, 0}), address(address), dataFd(dataFd), aliasFd(-1) {
 		mmap = hijacker.getLibKernelFunctionAddress(nid::mmap);
 		munmap = hijacker.getLibKernelFunctionAddress(nid::munmap);
+		close = hijacker.getLibKernelFunctionAddress(nid::close);
 		sceKernelJitCreateSharedMemory = hijacker.getLibKernelFunctionAddress(nid::sceKernelJitCreateSharedMemory);
+		sceKernelJitCreateAliasOfSharedMemory = hijacker.getLibKernelFunctionAddress(nid::sceKernelJitCreateAliasOfSharedMemory);
 		errno = hijacker.getLibKernelFunctionAddress(nid::errno);
-		info = hijacker.getDataAllocator().allocate(sizeof(AllocationInfo) * infoCount);
+		info = hijacker.allocateScratch(sizeof(AllocationInfo) * infoCount);
 		numInfo = infoCount;
 	}
 };
 
-static bool isAlive(int v) {
-	for (int pid : dbg::getAllPids()) {
-		if (pid == v) {
-			return true;
+static uintptr_t runAllocatorShellcode(Hijacker *hijacker, Array<AllocationInfo> &infos, const uintptr_t entry, const size_t loadable, int dataFd, int &aliasFd) {
+	// the last attempt lets the shellcode probe for a range with mmap instead of using the vm map
+	static constexpr int MAX_ATTEMPTS = 3;
+	static constexpr int32_t STATE_COLLIDED = 6;
+
+	size_t totalSize = 0;
+	for (size_t i = 0; i < loadable; i++) {
+		totalSize += infos[i].length;
+	}
+
+	AllocatorArgs args{*hijacker, (int) loadable, 0, dataFd};
+	ScopedScratch scratch{hijacker};
+	const auto argbuf = hijacker->allocateScratch(sizeof(args));
+	if (argbuf == 0 || args.info == 0) [[unlikely]] {
+		puts("no scratch memory for the allocator shellcode");
+		return 0;
+	}
+
+	for (int attempt = 1; attempt <= MAX_ATTEMPTS; attempt++) {
+		// reread the map every time since the range is only free until something else maps it
+		args.address = attempt < MAX_ATTEMPTS ? hijacker->findFreeRegion(totalSize, PAGE_SIZE) : 0;
+		args.result = {0, 0};
+		args.aliasFd = -1;
+		hijacker->write(argbuf, &args, sizeof(args));
+		hijacker->write(args.info, infos.data(), sizeof(AllocationInfo) * loadable);
+
+		puts("running allocator shellcode");
+		hijacker->call<void>(entry, argbuf);
+		if (hijacker->getLastCallError() == -1) [[unlikely]] {
+			printf("process died during allocation\n");
+			return 0;
+		}
+
+		hijacker->read(argbuf, &args, sizeof(args));
+		const int32_t state = args.result.state;
+		const int32_t err = args.result.err;
+		if (state == 1) [[likely]] {
+			hijacker->read(args.info, infos.data(), sizeof(AllocationInfo) * loadable);
+			aliasFd = args.aliasFd;
+			return infos[0].result;
+		}
+		if (state == STATE_COLLIDED) {
+			// the shellcode undid its mappings and kept the data file open for the retry
+			printf("0x%llx was mapped by the process after the vm map was read: %s\n",
+				(unsigned long long) args.address, strerror(err));
+			continue;
+		}
+		if (state == 3) {
+			printf("sceKernelJitCreateSharedMemory failed %d\n", err);
+		} else {
+			printf("Allocator shellcode failed. state: %d, err: %d %s\n", state, err, strerror(err));
 		}
+		return 0;
 	}
-	return false;
+	return 0;
 }
 
-static uintptr_t runAllocatorShellcode(Hijacker *hijacker, Array<AllocationInfo> &infos, const uintptr_t entry, const size_t loadable) {
-	AllocatorArgs args{*hijacker, (int) loadable};
-	const auto argbuf = hijacker->getDataAllocator().allocate(sizeof(args));
-	hijacker->write(argbuf, &args, sizeof(args));
-	hijacker->write(args.info, infos.data(), sizeof(AllocationInfo) * loadable);
+int Elf::shareData() {
+	const int fd = shm_open(SHM_ANON, O_RDWR, 0600);
+	if (fd == -1) [[unlikely]] {
+		return -1;
+	}
 
-	const int pid = hijacker->getPid();
-	puts("running allocator shellcode");
-	{
-		ScopedSuspender suspender{hijacker};
-
-		usleep(10);
-
-		// hold the reference to keep this alive
-		auto frame = hijacker->getTrapFrame();
-		frame->setRdi(argbuf)
-			.setRip(entry)
-			.flush();
-
-		hijacker->resume();
-		printf("waiting for allocator to finish\n");
-		do {
-			usleep(10);
-			if (!isAlive(pid)) {
-				printf("process died during allocation\n");
-				return 0;
-			}
-			hijacker->read(argbuf, &args, sizeof(args));
-			printf("state: %i\n", args.result.state);
-		} while (args.result.state == 0);
-
-		if (args.result.state != 1) [[unlikely]] {
-			int32_t state = args.result.state;
-			int32_t err = args.result.err;
-			if (state == 3) {
-				printf("sceKernelJitCreateSharedMemory failed %d\n", err);
+	int remoteFd = -1;
+	if (ftruncate(fd, sharedDataLength) != -1) [[likely]] {
+		void *local = mmap(nullptr, sharedDataLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (local != MAP_FAILED) [[likely]] {
+			// the allocator shellcode closes it once the segments are mapped
+			// the mapping keeps the shared memory object alive once fd is moved into the target
+			remoteFd = hijacker->shareFile(fd);
+			if (remoteFd != -1) [[likely]] {
+				sharedData = (uint8_t *) local;
 			} else {
-				printf("Allocator shellcode failed. state: %d, err: %d %s\n", state, err, strerror(err));
+				munmap(local, sharedDataLength);
 			}
-			return 0;
 		}
 	}
-	hijacker->read(args.info, infos.data(), sizeof(AllocationInfo) * loadable);
-	return infos[0].result;
+
+	if (remoteFd == -1) [[unlikely]] {
+		close(fd);
+		puts("failed to share the data segments, falling back to the debugger");
+	}
+	return remoteFd;
 }
 
 bool Elf::processProgramHeaders() {
-	uintptr_t entry = hijacker->getTextAllocator().allocate(sizeof(ALLOCATOR_SHELLCODE));
-	hijacker->write(entry, ALLOCATOR_SHELLCODE);
+	uintptr_t entry = hijacker->loadCode(ALLOCATOR_SHELLCODE);
+	if (entry == 0) [[unlikely]] {
+		puts("no space for the allocator shellcode");
+		return false;
+	}
 
 	int text = -1;
 	//int ehFrameHdr = -1;
@@ -561,10 +616,13 @@ bool Elf::processProgramHeaders() {
 	}
 	Array<AllocationInfo> infos{loadable};
 	const auto *__restrict phdr = phdrs + text;
-	infos[0] = {phdr->p_paddr, (phdr->p_memsz + 0x3FFF) & 0xFFFFC000, 0, toMmapProt(phdr)};
+	infos[0] = {phdr->p_paddr, (phdr->p_memsz + 0x3FFF) & 0xFFFFC000, 0, toMmapProt(phdr), 0};
+	segments = Array<uint8_t *>{e_phnum};
+	bool canShareData = true;
 	{
 		for (size_t i = 0, j = 1; i < e_phnum; i++) {
 			const auto *__restrict phdr = phdrs + i;
+			segments[i] = nullptr;
 			if (isLoadable(phdr)) {
 				if (phdr->p_flags & PF_X) {
 					// skip text
@@ -574,19 +632,52 @@ bool Elf::processProgramHeaders() {
 					printf("phdr starting at paddr 0x%llx is not page aligned\n", phdr->p_paddr);
 					return false;
 				}
-				infos[j++] = {phdr->p_paddr, (phdr->p_memsz + 0x3FFF) & 0xFFFFC000, 0, toMmapProt(phdr)};
+				if (phdr->p_type != PT_LOAD) [[unlikely]] {
+					// it overlaps another segment and would be backed by different pages
+					canShareData = false;
+				}
+				const uint64_t length = (phdr->p_memsz + 0x3FFF) & 0xFFFFC000;
+				infos[j++] = {phdr->p_paddr, length, 0, toMmapProt(phdr), sharedDataLength};
+				sharedDataLength += length;
 			}
 		}
 	}
 
+	int dataFd = -1;
+	if (canShareData && sharedDataLength != 0) {
+		dataFd = shareData();
+	}
 
-
-	imagebase = runAllocatorShellcode(hijacker, infos, entry, loadable);
+	int aliasFd = -1;
+	imagebase = runAllocatorShellcode(hijacker, infos, entry, loadable, dataFd, aliasFd);
 
 	if (imagebase == 0) {
 		return false;
 	}
 
+	if (sharedData != nullptr) {
+		for (size_t i = 0, j = 1; i < e_phnum; i++) {
+			const auto *__restrict phdr = phdrs + i;
+			if (isLoadable(phdr) && !(phdr->p_flags & PF_X)) {
+				segments[i] = sharedData + infos[j++].offset;
+			}
+		}
+	}
+
+	if (aliasFd != -1) {
+		sharedTextLength = infos[0].length;
+		sharedText = (uint8_t *) hijacker->mapRemoteFile(aliasFd, sharedTextLength, PROT_READ | PROT_WRITE);
+		if (sharedText != nullptr) [[likely]] {
+			segments[text] = sharedText;
+		} else {
+			puts("failed to map the text alias, falling back to the debugger");
+		}
+		// our mapping holds its own reference, the target must not keep a writable alias of its text
+		if (hijacker->call<int>(hijacker->getLibKernelFunctionAddress(nid::close), aliasFd) != 0) [[unlikely]] {
+			printf("failed to close the text alias in the target: %s\n", strerror(hijacker->getLastCallError()));
+		}
+	}
+
 	// Note: the eh_frame entries in the eboot SharedLib object
 	// may need to be set for exceptions to work, idk yet
 
@@ -632,16 +723,14 @@ struct KernelRWArgs {
 		int err;
 	} result;
 	uintptr_t files;
-	uintptr_t usleep;
 	uintptr_t socket;
 	uintptr_t pipe;
 	uintptr_t setsockopt;
 	uintptr_t errno;
 
 	KernelRWArgs(Hijacker& hijacker) : result({0, 0}) {
-		auto &alloc = hijacker.getDataAllocator();
-		files = alloc.allocate(sizeof(int[4]));
-		usleep = hijacker.getLibKernelFunctionAddress(nid::usleep);
+		// these are used by the payload for as long as it runs
+		files = hijacker.allocateData(sizeof(int[4]));
 		socket = hijacker.getLibKernelFunctionAddress(nid::socket);
 		pipe = hijacker.getLibKernelFunctionAddress(nid::pipe);
 		setsockopt = hijacker.getLibKernelFunctionAddress(nid::setsockopt);
@@ -651,47 +740,75 @@ struct KernelRWArgs {
 
 uintptr_t Elf::setupKernelRW() {
 	KernelRWArgs args{*hijacker};
-	auto &alloc = hijacker->getDataAllocator();
-	const auto argbuf = alloc.allocate(sizeof(args));
+	ScopedScratch scratch{hijacker};
+	const auto argbuf = hijacker->allocateScratch(sizeof(args));
+	if (argbuf == 0 || args.files == 0) [[unlikely]] {
+		puts("no memory for the kernelrw shellcode arguments");
+		return 0;
+	}
 	hijacker->write(argbuf, &args, sizeof(args));
 
-	ProcessPointer<int32_t> res = hijacker->getPointer<int32_t>(argbuf);
-
-	const auto code = hijacker->getTextAllocator().allocate(sizeof(KERNELRW_SHELLCODE));
-	hijacker->write(code, KERNELRW_SHELLCODE, sizeof(KERNELRW_SHELLCODE));
-	{
-		ScopedSuspender suspender{hijacker};
-		*res = 0;
-		hijacker->getTrapFrame()->setRdi(argbuf)
-			.setRip(code)
-			.flush();
-
-		hijacker->resume();
-		while (*res == 0) {
-			usleep(10);
-		}
+	const auto code = hijacker->loadCode(KERNELRW_SHELLCODE);
+	if (code == 0) [[unlikely]] {
+		puts("no space for the kernelrw shellcode");
+		return 0;
+	}
+	hijacker->call<void>(code, argbuf);
+	if (hijacker->getLastCallError() == -1) [[unlikely]] {
+		puts("process died while setting up kernelrw");
+		return 0;
 	}
 
 	int files[4];
-	hijacker->read(args.files, files, sizeof(files));
+	KernelRWArgs::Result state{0, 0};
+	const dbg::ReadOp ops[]{
+		{args.files, files, sizeof(files)},
+		{argbuf, &state, sizeof(state)}
+	};
+	if (hijacker->readv(ops, sizeof(ops) / sizeof(ops[0])) != 0) [[unlikely]] {
+		puts("failed to read kernelrw shellcode results");
+		return 0;
+	}
 
 	if (files[0] == -1 || files[1] == -1 || files[2] == -1 || files[3] == -1) {
-		hijacker->read(argbuf, &args, sizeof(args));
-		if (args.result.err != 0) {
-			printf("failed to obtain master/victim sockets and kernelrw pipes\n%s\n", strerror(args.result.err));
+		if (state.err != 0) {
+			printf("failed to obtain master/victim sockets and kernelrw pipes\n%s\n", strerror(state.err));
 		} else {
 			puts("failed to obtain master/victim sockets and kernelrw pipes");
 		}
 		return 0;
 	}
 
-	auto newtbl = hijacker->getProc()->getFdTbl();
-	auto sock = newtbl.getFileData(files[0]);
+	// the sockets and pipes are opened one after the other so one snapshot covers them
+	int lowest = files[0];
+	int highest = files[0];
+	for (int fd : files) {
+		lowest = fd < lowest ? fd : lowest;
+		highest = fd > highest ? fd : highest;
+	}
+	const auto open = hijacker->getProc()->getFdTbl().snapshot(lowest, highest + 1);
+	auto find = [&open](int fd) -> const FdEntry * {
+		for (const FdEntry &entry : open) {
+			if (entry.fd == fd) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	};
+	const FdEntry *master = find(files[0]);
+	const FdEntry *victim = find(files[1]);
+	const FdEntry *rwpipe = find(files[2]);
+	if (master == nullptr || victim == nullptr || rwpipe == nullptr) [[unlikely]] {
+		puts("kernelrw sockets and pipes are missing from the file table");
+		return 0;
+	}
+
+	auto sock = master->data;
 	kwrite<uint32_t>(sock, 0x100);
 	auto pcb = kread<uintptr_t>(sock + 0x18);
 	auto master_inp6_outputopts = kread<uintptr_t>(pcb + 0x120);
 	printf("master_inp6_outputopts: 0x%08llx\n", master_inp6_outputopts);
-	sock = newtbl.getFileData(files[1]);
+	sock = victim->data;
 	kwrite<uint32_t>(sock, 0x100);
 	pcb = kread<uintptr_t>(sock + 0x18);
 	auto victim_inp6_outputopts = kread<uintptr_t>(pcb + 0x120);
@@ -699,7 +816,7 @@ uintptr_t Elf::setupKernelRW() {
 	printf("victim_pktinfo: 0x%08llx\n", victim_inp6_outputopts + 0x10);
 	kwrite(master_inp6_outputopts + 0x10, victim_inp6_outputopts + 0x10);
 	kwrite<uint32_t>(master_inp6_outputopts + 0xc0, 0x13370000);
-	const uintptr_t pipeaddr = kread<uintptr_t>(newtbl.getFile(files[2]));
+	const uintptr_t pipeaddr = rwpipe->data;
 
 	struct payload_args result = {
 		.dlsym = (dlsym_t *) hijacker->getLibKernelFunctionAddress(nid::sceKernelDlsym),
@@ -707,14 +824,200 @@ uintptr_t Elf::setupKernelRW() {
 		.rwpair = (int *) args.files,
 		.kpipe_addr = pipeaddr,
 		.kdata_base_addr = kernel_base,
-		.payloadout = (int *) alloc.allocate(sizeof(int))
+		.payloadout = (int *) hijacker->allocateData(sizeof(int))
 	};
 
-	uintptr_t addr = alloc.allocate(sizeof(struct payload_args));
+	uintptr_t addr = hijacker->allocateData(sizeof(struct payload_args));
+	if (addr == 0 || result.payloadout == nullptr) [[unlikely]] {
+		puts("no memory for the payload arguments");
+		return 0;
+	}
 	hijacker->write(addr, &result, sizeof(result));
 	return addr;
 }
 
+struct ResolverArgs {
+	struct Result {
+		int32_t state;
+		int32_t err;
+	} result;
+	uintptr_t sceKernelDlsym;
+	uintptr_t strtab;
+	uintptr_t handles;
+	uintptr_t names;
+	uintptr_t addresses;
+	int numHandles;
+	int numNames;
+
+	ResolverArgs(Hijacker &hijacker, size_t strtabLength, int numHandles, int numNames) :
+			result({0, 0}), numHandles(numHandles), numNames(numNames) {
+		sceKernelDlsym = hijacker.getLibKernelFunctionAddress(nid::sceKernelDlsym);
+		strtab = hijacker.allocateScratch(strtabLength);
+		handles = hijacker.allocateScratch(sizeof(int) * numHandles);
+		names = hijacker.allocateScratch(sizeof(uint32_t) * numNames);
+		addresses = hijacker.allocateScratch(sizeof(uintptr_t) * numNames);
+	}
+};
+
+bool Elf::resolveImportsInTarget() {
+	// collect the distinct undefined symbols referenced by the relocations
+	Array<uint32_t> indices{symtabLength};
+	Array<bool> seen{symtabLength};
+	__builtin_memset(seen.data(), 0, symtabLength);
+	size_t count = 0;
+	String names{};
+	const Elf64_Rela *tables[]{relatbl, plt};
+	const size_t lengths[]{relaLength, pltLength};
+	for (size_t t = 0; t < 2; t++) {
+		if (tables[t] == nullptr) {
+			continue;
+		}
+		for (size_t i = 0; i < lengths[t]; i++) {
+			const uint32_t index = ELF64_R_SYM(tables[t][i].r_info);
+			if (index == 0 || index >= symtabLength || seen[index] || symtab[index].st_value != 0) {
+				continue;
+			}
+			seen[index] = true;
+			indices[count++] = index;
+		}
+	}
+
+	if (count == 0) {
+		return true;
+	}
+
+	// only the names which are needed are uploaded
+	Array<uint32_t> nameOffsets{count};
+	for (size_t i = 0; i < count; i++) {
+		nameOffsets[i] = names.length();
+		names += strtab + symtab[indices[i]].st_name;
+		names += '\0';
+	}
+
+	const size_t numHandles = libs.length();
+	Array<int> handles{numHandles};
+	for (size_t i = 0; i < numHandles; i++) {
+		handles[i] = libs[i].lib->handle();
+	}
+
+	ScopedScratch scratch{hijacker};
+	ResolverArgs args{*hijacker, names.length(), (int) numHandles, (int) count};
+	const uintptr_t argbuf = hijacker->allocateScratch(sizeof(args));
+	if (argbuf == 0 || args.strtab == 0 || args.handles == 0 || args.names == 0 || args.addresses == 0) [[unlikely]] {
+		puts("no scratch memory for the resolver shellcode");
+		return false;
+	}
+	hijacker->write(argbuf, &args, sizeof(args));
+	hijacker->write(args.strtab, names.c_str(), names.length());
+	hijacker->write(args.handles, handles.data(), sizeof(int) * numHandles);
+	hijacker->write(args.names, nameOffsets.data(), sizeof(uint32_t) * count);
+
+	const uintptr_t entry = hijacker->loadCode(RESOLVER_SHELLCODE);
+	if (entry == 0) [[unlikely]] {
+		puts("no space for the resolver shellcode");
+		return false;
+	}
+	hijacker->call<void>(entry, argbuf);
+	if (hijacker->getLastCallError() == -1) [[unlikely]] {
+		puts("process died while resolving imports");
+		return false;
+	}
+
+	const auto res = hijacker->read<ResolverArgs::Result>(argbuf);
+	if (res.state != 1) [[unlikely]] {
+		printf("failed to resolve %s in the target\n", names.c_str() + nameOffsets[res.err]);
+		return false;
+	}
+
+	Array<uintptr_t> addresses{count};
+	hijacker->read(args.addresses, addresses.data(), sizeof(uintptr_t) * count);
+
+	imports = Array<uintptr_t>{symtabLength};
+	__builtin_memset(imports.data(), 0, sizeof(uintptr_t) * symtabLength);
+	for (size_t i = 0; i < count; i++) {
+		imports[indices[i]] = addresses[i];
+	}
+	numImports = count;
+	return true;
+}
+
+void Elf::fillSymbolTables() {
+	for (auto &lib : libs) {
+		lib.fillTable();
+	}
+}
+
+// fills the symbol tables and checks them against the imports resolved in the target
+void Elf::compareImports() {
+	const uint64_t start = getMicroseconds();
+	fillSymbolTables();
+	printf("filled the symbol tables in %llu us\n", (unsigned long long) (getMicroseconds() - start));
+	size_t mismatches = 0;
+	for (size_t i = 1; i < symtabLength; i++) {
+		if (imports[i] == 0) {
+			continue;
+		}
+		const char *name = strtab + symtab[i].st_name;
+		const uintptr_t expected = findLibrarySymbol(name);
+		if (expected != imports[i]) [[unlikely]] {
+			printf("%s resolved to 0x%llx in the target but 0x%llx in the tables\n",
+				name, (unsigned long long) imports[i], (unsigned long long) expected);
+			mismatches++;
+		}
+	}
+	printf("%llu of %llu imports differ\n", (unsigned long long) mismatches, (unsigned long long) numImports);
+}
+
+bool Elf::resolveImports() {
+	if (symtab == nullptr || strtab == nullptr) [[unlikely]] {
+		return true;
+	}
+
+	uint64_t start = getMicroseconds();
+	if (resolveInTarget && symtabLength != 0) {
+		if (resolveImportsInTarget()) [[likely]] {
+			printf("resolved %llu imports in the target in %llu us\n",
+				(unsigned long long) numImports, (unsigned long long) (getMicroseconds() - start));
+			if (verifyImports) [[unlikely]] {
+				compareImports();
+			}
+			return true;
+		}
+		puts("falling back to resolving imports with the symbol tables");
+		imports = nullptr;
+		start = getMicroseconds();
+	}
+
+	fillSymbolTables();
+	printf("filled the symbol tables in %llu us\n", (unsigned long long) (getMicroseconds() - start));
+	return true;
+}
+
+// stages the data in the mailbox for the agent to copy into place
+static bool copyThroughAgent(Hijacker *hijacker, Agent *agent, uintptr_t dst, const uint8_t *src, size_t length) {
+	static constexpr size_t CHUNK_SIZE = 0x1000;
+	ScopedScratch scratch{hijacker};
+	Mailbox *mailbox = hijacker->getMailbox();
+	const uintptr_t buffers[2]{mailbox->allocate(CHUNK_SIZE), mailbox->allocate(CHUNK_SIZE)};
+	if (buffers[0] == 0 || buffers[1] == 0) [[unlikely]] {
+		return false;
+	}
+
+	// fill one buffer while the agent copies from the other
+	uint32_t tickets[2]{};
+	bool pending[2]{};
+	for (size_t offset = 0, i = 0; offset < length; offset += CHUNK_SIZE, i ^= 1) {
+		if (pending[i] && !agent->wait(tickets[i])) [[unlikely]] {
+			return false;
+		}
+		const size_t n = length - offset < CHUNK_SIZE ? length - offset : CHUNK_SIZE;
+		__builtin_memcpy(mailbox->toLocal(buffers[i]), src + offset, n);
+		tickets[i] = agent->copy(dst + offset, buffers[i], n);
+		pending[i] = true;
+	}
+	return agent->flush();
+}
+
 bool Elf::load() {
 	for (size_t i = 0; i < e_phnum; i++) {
 		const Elf64_Phdr *__restrict phdr = phdrs + i;
@@ -729,6 +1032,21 @@ bool Elf::load() {
 			continue;
 		}
 
+		uint8_t *local = segments[i];
+		if (local != nullptr) [[likely]] {
+			// the pages are shared with the process
+			__builtin_memcpy(local, data.get() + phdr->p_offset, phdr->p_filesz);
+			continue;
+		}
+
+		Agent *agent = hijacker->getRunningAgent();
+		if (agent != nullptr && (phdr->p_flags & PF_W)) {
+			// the agent can only copy into pages which are writable in the process
+			if (copyThroughAgent(hijacker, agent, vaddr, data.get() + phdr->p_offset, phdr->p_filesz)) [[likely]] {
+				continue;
+			}
+		}
+
 		int j = 0;
 		while (!hijacker->write(vaddr, data.get() + phdr->p_offset, phdr->p_filesz)) {
 			printf("failed to write section data for phdr with paddr 0x%08llx\n", phdr->p_paddr);
@@ -741,6 +1059,11 @@ bool Elf::load() {
 }
 
 bool Elf::launch() {
+	dbg::Session session{};
+	// every step after this is serviced by the agent instead of hijacking the main thread
+	if (hijacker->getAgent() == nullptr) [[unlikely]] {
+		puts("agent unavailable, falling back to hijacking the main thread for each step");
+	}
 	puts("processing program headers");
 	if (!processProgramHeaders()) [[unlikely]] {
 		return false;
@@ -749,6 +1072,10 @@ bool Elf::launch() {
 	if (!parseDynamicTable()) [[unlikely]] {
 		return false;
 	}
+	puts("resolving imports");
+	if (!resolveImports()) [[unlikely]] {
+		return false;
+	}
 	puts("processing relocations");
 	if (!processRelocations()) [[unlikely]] {
 		return false;
@@ -773,12 +1100,44 @@ bool Elf::launch() {
 	return start(args);
 }
 
+bool Elf::startThread(uintptr_t args) {
+	const uintptr_t fn = hijacker->getLibKernelFunctionAddress(nid::pthread_create);
+	ScopedScratch scratch{hijacker};
+	const uintptr_t thread = hijacker->allocateScratch(sizeof(uintptr_t));
+	if (thread == 0) [[unlikely]] {
+		puts("no scratch memory for the payload thread id");
+		return false;
+	}
+	const int err = hijacker->call<int>(fn, thread, 0, imagebase + e_entry, args);
+	if (hijacker->getLastCallError() == -1) [[unlikely]] {
+		puts("process died while starting the payload thread");
+		return false;
+	}
+	if (err != 0) [[unlikely]] {
+		printf("failed to create the payload thread: %s\n", strerror(err));
+		return false;
+	}
+	puts("great success");
+	return true;
+}
+
 bool Elf::start(uintptr_t args) {
-	ScopedSuspender suspender{hijacker};
-	auto frame = hijacker->getTrapFrame();
+	if (!hijacker->hasSavedRsp()) {
+		// the main thread of a process we didn't spawn is still in use
+		return startThread(args);
+	}
 
 	const uintptr_t rsp = hijacker->getSavedRsp();
 
+	if (Agent *agent = hijacker->getRunningAgent()) [[likely]] {
+		agent->start(imagebase + e_entry, rsp, args);
+		puts("great success");
+		return true;
+	}
+
+	ScopedSuspender suspender{hijacker};
+	auto frame = hijacker->getTrapFrame();
+
 	frame->setRsp(rsp)
 		.setRbp(0)
 		.setRdi(args)
@@ -793,20 +1152,35 @@ uintptr_t Elf::getSymbolAddress(const Elf64_Rela *__restrict rel) const {
 	if (symtab == nullptr || strtab == nullptr) [[unlikely]] {
 		return true;
 	}
-	const Elf64_Sym *__restrict sym = symtab + ELF64_R_SYM(rel->r_info);
+	const size_t index = ELF64_R_SYM(rel->r_info);
+	const Elf64_Sym *__restrict sym = symtab + index;
 	if (sym->st_value != 0) {
 		// the symbol exists in our elf
 		// this can only occur if you're loading a library instead of an executable
 		// this was a mistake and I'm an idiot but it may be useful in the future
 		return imagebase + sym->st_value;
 	}
+	if (imports) {
+		// resolved in the target
+		const uintptr_t addr = imports[index];
+		if (addr != 0) [[likely]] {
+			return addr;
+		}
+	}
+	const uintptr_t addr = findLibrarySymbol(strtab + sym->st_name);
+	if (addr == 0) [[unlikely]] {
+		printf("symbol lookup for %s failed\n", strtab + sym->st_name);
+	}
+	return addr;
+}
+
+uintptr_t Elf::findLibrarySymbol(const char *name) const {
 	for (auto &lib : libs) {
-		auto libsym = lib[strtab + sym->st_name];
+		auto libsym = lib[name];
 		if (libsym && libsym.exported()) {
 			return libsym.vaddr();
 		}
 	}
-	printf("symbol lookup for %s failed\n", strtab + sym->st_name);
 	return 0;
 }
 
@@ -885,87 +1259,120 @@ namespace {
 
 // see shellcode/libloader.cpp for source
 uint8_t LIBLOADER_SHELLCODE[]{
-	0x55, 0x41, 0x57, 0x41, 0x56, 0x41, 0x55, 0x41, 0x54, 0x53, 0x50, 0x44, 0x8b, 0x77, 0x28, 0x48,
-	0x89, 0xfb, 0x45, 0x85, 0xf6, 0x7e, 0x43, 0x4c, 0x8b, 0x63, 0x08, 0x4c, 0x8b, 0x6b, 0x18, 0x48,
-	0x8b, 0x6b, 0x20, 0x45, 0x31, 0xff, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x4a, 0x8b, 0x7c, 0xfd, 0x00, 0x31, 0xf6, 0x31, 0xd2, 0x31, 0xc9, 0x45, 0x31, 0xc0, 0x45, 0x31,
-	0xc9, 0x4c, 0x01, 0xef, 0x41, 0xff, 0xd4, 0x85, 0xc0, 0x7e, 0x2e, 0x89, 0xc0, 0x4a, 0x89, 0x44,
-	0xfd, 0x00, 0x49, 0xff, 0xc7, 0x4d, 0x39, 0xfe, 0x75, 0xd6, 0xc7, 0x03, 0x01, 0x00, 0x00, 0x00,
-	0x48, 0x8b, 0x5b, 0x10, 0x66, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0xd3, 0xeb, 0xf7, 0xc7, 0x03, 0x02, 0x00, 0x00, 0x00, 0x44,
-	0x89, 0x7b, 0x04, 0x48, 0x8b, 0x5b, 0x10, 0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0xd3, 0xeb, 0xf7
+	0x41, 0x54, 0x55, 0x53, 0x48, 0x89, 0xfb, 0x8b, 0x47, 0x20, 0x85, 0xc0, 0x7e, 0x62, 0x48, 0x8b,
+	0x57, 0x18, 0x31, 0xed, 0xeb, 0x1c, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x48, 0x8b, 0x53, 0x18, 0x48, 0x98, 0x48, 0xff, 0xc5, 0x4a, 0x89, 0x04, 0x22, 0x39, 0x6b, 0x20,
+	0x7e, 0x3e, 0x4c, 0x8d, 0x24, 0xed, 0x00, 0x00, 0x00, 0x00, 0x45, 0x31, 0xc9, 0x45, 0x31, 0xc0,
+	0x4a, 0x8b, 0x3c, 0x22, 0x48, 0x03, 0x7b, 0x10, 0x31, 0xc9, 0x31, 0xd2, 0x31, 0xf6, 0xff, 0x53,
+	0x08, 0x85, 0xc0, 0x7f, 0xcb, 0xc7, 0x03, 0x02, 0x00, 0x00, 0x00, 0x89, 0x6b, 0x04, 0x5b, 0x5d,
+	0x41, 0x5c, 0xc3, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x90,
+	0xc7, 0x03, 0x01, 0x00, 0x00, 0x00, 0x5b, 0x5d, 0x41, 0x5c, 0xc3
 };
 
 // see shellcode/allocator.cpp for source
 uint8_t ALLOCATOR_SHELLCODE[]{
-	0x55, 0x41, 0x57, 0x41, 0x56, 0x41, 0x55, 0x41, 0x54, 0x53, 0x50, 0x44, 0x8b, 0x67, 0x38, 0x48,
-	0x89, 0xfb, 0x45, 0x85, 0xe4, 0x7e, 0x14, 0x48, 0x8b, 0x43, 0x30, 0x41, 0x83, 0xfc, 0x11, 0x73,
-	0x12, 0x31, 0xc9, 0x45, 0x31, 0xf6, 0xe9, 0x11, 0x01, 0x00, 0x00, 0x45, 0x31, 0xf6, 0xe9, 0x29,
-	0x01, 0x00, 0x00, 0x44, 0x89, 0xe1, 0xba, 0x10, 0x00, 0x00, 0x00, 0xc5, 0xf9, 0xef, 0xc0, 0xc5,
-	0xf1, 0xef, 0xc9, 0xc5, 0xe9, 0xef, 0xd2, 0xc5, 0xe1, 0xef, 0xdb, 0x83, 0xe1, 0x0f, 0x48, 0x0f,
-	0x45, 0xd1, 0x4c, 0x89, 0xe1, 0x48, 0x29, 0xd1, 0x48, 0x8d, 0x90, 0x88, 0x01, 0x00, 0x00, 0x48,
-	0x89, 0xce, 0x66, 0x66, 0x66, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0xc5, 0xfe, 0x6f, 0xa2, 0x80, 0xfe, 0xff, 0xff, 0xc5, 0xfe, 0x6f, 0xaa, 0xa0, 0xfe, 0xff, 0xff,
-	0xc5, 0xfe, 0x6f, 0xb2, 0x00, 0xff, 0xff, 0xff, 0xc5, 0xfe, 0x6f, 0xba, 0x20, 0xff, 0xff, 0xff,
-	0xc4, 0xe3, 0x5d, 0x46, 0xa2, 0xc0, 0xfe, 0xff, 0xff, 0x20, 0xc4, 0xe3, 0x55, 0x46, 0xaa, 0xe0,
-	0xfe, 0xff, 0xff, 0x20, 0xc5, 0xdd, 0x6c, 0xe5, 0xc4, 0xe3, 0x4d, 0x46, 0xaa, 0x40, 0xff, 0xff,
-	0xff, 0x20, 0xc4, 0xe3, 0x45, 0x46, 0xb2, 0x60, 0xff, 0xff, 0xff, 0x20, 0xc5, 0xfe, 0x6f, 0x7a,
-	0xa0, 0xc5, 0xdd, 0xd4, 0xc0, 0xc4, 0xe3, 0x45, 0x46, 0x62, 0xe0, 0x20, 0xc5, 0xd5, 0x6c, 0xee,
-	0xc5, 0xfe, 0x6f, 0x72, 0x80, 0xc5, 0xd5, 0xd4, 0xc9, 0xc5, 0xfe, 0x6f, 0x6a, 0x20, 0xc4, 0xe3,
-	0x4d, 0x46, 0x72, 0xc0, 0x20, 0xc4, 0xe3, 0x55, 0x46, 0x6a, 0x60, 0x20, 0xc5, 0xcd, 0x6c, 0xe4,
-	0xc5, 0xfe, 0x6f, 0x32, 0xc5, 0xdd, 0xd4, 0xd2, 0xc4, 0xe3, 0x4d, 0x46, 0x72, 0x40, 0x20, 0x48,
-	0x81, 0xc2, 0x00, 0x02, 0x00, 0x00, 0x48, 0x83, 0xc6, 0xf0, 0xc5, 0xcd, 0x6c, 0xe5, 0xc5, 0xdd,
-	0xd4, 0xdb, 0x0f, 0x85, 0x58, 0xff, 0xff, 0xff, 0xc5, 0xf5, 0xd4, 0xc0, 0xc5, 0xed, 0xd4, 0xc0,
-	0xc5, 0xe5, 0xd4, 0xc0, 0xc4, 0xe3, 0x7d, 0x39, 0xc1, 0x01, 0xc5, 0xf9, 0xd4, 0xc1, 0xc5, 0xf9,
-	0x70, 0xc8, 0xee, 0xc5, 0xf9, 0xd4, 0xc1, 0xc4, 0xc1, 0xf9, 0x7e, 0xc6, 0x4c, 0x89, 0xe2, 0x48,
-	0x29, 0xca, 0x48, 0xc1, 0xe1, 0x05, 0x48, 0x8d, 0x44, 0x01, 0x08, 0x0f, 0x1f, 0x44, 0x00, 0x00,
-	0x4c, 0x03, 0x30, 0x48, 0x83, 0xc0, 0x20, 0x48, 0xff, 0xca, 0x75, 0xf4, 0x4c, 0x8b, 0x6b, 0x10,
-	0x31, 0xff, 0x4c, 0x89, 0xf6, 0xba, 0x01, 0x00, 0x00, 0x00, 0xb9, 0x02, 0x10, 0x00, 0x00, 0x41,
-	0xb8, 0xff, 0xff, 0xff, 0xff, 0x45, 0x31, 0xc9, 0xc5, 0xf8, 0x77, 0x41, 0xff, 0xd5, 0x48, 0x83,
-	0xf8, 0xff, 0x0f, 0x84, 0xf1, 0x00, 0x00, 0x00, 0x48, 0x89, 0xc7, 0x4c, 0x89, 0xf6, 0x49, 0x89,
-	0xc7, 0xff, 0x53, 0x18, 0x48, 0x8b, 0x6b, 0x30, 0x48, 0x8d, 0x4c, 0x24, 0x04, 0x31, 0xff, 0xba,
-	0x07, 0x00, 0x00, 0x00, 0x4c, 0x8b, 0x75, 0x08, 0xc7, 0x44, 0x24, 0x04, 0xff, 0xff, 0xff, 0xff,
-	0x4c, 0x89, 0xf6, 0xff, 0x53, 0x20, 0x85, 0xc0, 0x0f, 0x85, 0xdb, 0x00, 0x00, 0x00, 0x44, 0x8b,
-	0x44, 0x24, 0x04, 0x4c, 0x89, 0xff, 0x4c, 0x89, 0xf6, 0xba, 0x04, 0x00, 0x00, 0x00, 0xb9, 0x11,
-	0x00, 0x00, 0x00, 0x45, 0x31, 0xc9, 0x41, 0xff, 0xd5, 0x48, 0x89, 0x45, 0x10, 0x48, 0x83, 0xf8,
-	0xff, 0x0f, 0x84, 0xd2, 0x00, 0x00, 0x00, 0x41, 0x83, 0xfc, 0x02, 0x7c, 0x4a, 0x49, 0xc1, 0xe4,
-	0x05, 0x49, 0x89, 0xc6, 0x45, 0x31, 0xff, 0x49, 0x83, 0xc4, 0xe0, 0x0f, 0x1f, 0x44, 0x00, 0x00,
-	0x4a, 0x8b, 0x7c, 0x3d, 0x20, 0x4a, 0x8b, 0x74, 0x3d, 0x28, 0x42, 0x8b, 0x54, 0x3d, 0x38, 0xb9,
-	0x12, 0x10, 0x00, 0x00, 0x41, 0xb8, 0xff, 0xff, 0xff, 0xff, 0x45, 0x31, 0xc9, 0x4c, 0x01, 0xf7,
-	0x41, 0xff, 0xd5, 0x4a, 0x89, 0x44, 0x3d, 0x30, 0x48, 0x83, 0xf8, 0xff, 0x74, 0x2b, 0x49, 0x83,
-	0xc7, 0x20, 0x4d, 0x39, 0xfc, 0x75, 0xc9, 0xc7, 0x03, 0x01, 0x00, 0x00, 0x00, 0x48, 0x8b, 0x5b,
-	0x08, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0xd3, 0xeb, 0xf7, 0xff, 0x53, 0x28, 0x8b, 0x00, 0xc7, 0x03,
-	0x05, 0x00, 0x00, 0x00, 0x89, 0x43, 0x04, 0x48, 0x8b, 0x5b, 0x08, 0x0f, 0x1f, 0x44, 0x00, 0x00,
-	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0xd3, 0xeb, 0xf7, 0xff, 0x53, 0x28, 0x8b, 0x00, 0xc7, 0x03,
-	0x02, 0x00, 0x00, 0x00, 0x89, 0x43, 0x04, 0x48, 0x8b, 0x5b, 0x08, 0x0f, 0x1f, 0x44, 0x00, 0x00,
-	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0xd3, 0xeb, 0xf7, 0xc7, 0x03, 0x03, 0x00, 0x00, 0x00, 0x89,
-	0x43, 0x04, 0x48, 0x8b, 0x5b, 0x08, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0xd3, 0xeb, 0xf7, 0xff, 0x53, 0x28, 0x8b, 0x00, 0xc7, 0x03,
-	0x04, 0x00, 0x00, 0x00, 0x89, 0x43, 0x04, 0x48, 0x8b, 0x5b, 0x08, 0x0f, 0x1f, 0x44, 0x00, 0x00,
-	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0xd3, 0xeb, 0xf7
+	0x41, 0x57, 0x41, 0x56, 0x41, 0x55, 0x41, 0xbd, 0x11, 0x40, 0x00, 0x00, 0x41, 0x54, 0x55, 0x53,
+	0x48, 0x89, 0xfb, 0x48, 0x83, 0xec, 0x28, 0x4c, 0x8b, 0x67, 0x40, 0xc7, 0x44, 0x24, 0x0c, 0x12,
+	0x50, 0x00, 0x00, 0x4d, 0x85, 0xe4, 0x0f, 0x84, 0x74, 0x02, 0x00, 0x00, 0x48, 0x8b, 0x43, 0x38,
+	0xc7, 0x44, 0x24, 0x18, 0xff, 0xff, 0xff, 0xff, 0x48, 0x8d, 0x4c, 0x24, 0x18, 0xba, 0x07, 0x00,
+	0x00, 0x00, 0x31, 0xff, 0x4c, 0x8b, 0x70, 0x08, 0x4c, 0x89, 0xf6, 0xff, 0x53, 0x20, 0x89, 0xc5,
+	0x85, 0xc0, 0x0f, 0x85, 0x68, 0x01, 0x00, 0x00, 0x4c, 0x89, 0xe7, 0x44, 0x8b, 0x44, 0x24, 0x18,
+	0x45, 0x31, 0xc9, 0x44, 0x89, 0xe9, 0xba, 0x04, 0x00, 0x00, 0x00, 0x4c, 0x89, 0xf6, 0xff, 0x53,
+	0x08, 0x49, 0x89, 0xc4, 0x48, 0x8b, 0x43, 0x38, 0x4c, 0x89, 0x60, 0x10, 0x49, 0x83, 0xfc, 0xff,
+	0x0f, 0x84, 0x8a, 0x02, 0x00, 0x00, 0x8b, 0x7c, 0x24, 0x18, 0xc7, 0x44, 0x24, 0x1c, 0xff, 0xff,
+	0xff, 0xff, 0x48, 0x8d, 0x54, 0x24, 0x1c, 0xbe, 0x03, 0x00, 0x00, 0x00, 0xff, 0x53, 0x28, 0x85,
+	0xc0, 0x0f, 0x85, 0xf9, 0x02, 0x00, 0x00, 0x8b, 0x44, 0x24, 0x1c, 0x83, 0x7b, 0x48, 0x01, 0x44,
+	0x8b, 0x73, 0x4c, 0x89, 0x43, 0x50, 0x0f, 0x8e, 0xb4, 0x01, 0x00, 0x00, 0x48, 0x8b, 0x53, 0x38,
+	0x41, 0xbf, 0x28, 0x00, 0x00, 0x00, 0xbd, 0x01, 0x00, 0x00, 0x00, 0x41, 0x83, 0xfe, 0xff, 0x75,
+	0x1e, 0xe9, 0x4a, 0x01, 0x00, 0x00, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xc5, 0x49, 0x83, 0xc7, 0x28, 0x39, 0x6b, 0x48, 0x0f, 0x8e, 0x91, 0x01, 0x00, 0x00, 0x4a,
+	0x8d, 0x04, 0x3a, 0x45, 0x89, 0xf0, 0x44, 0x89, 0xe9, 0x48, 0x8b, 0x38, 0x8b, 0x50, 0x18, 0x48,
+	0x8b, 0x70, 0x08, 0x4c, 0x8b, 0x48, 0x20, 0x4c, 0x01, 0xe7, 0xff, 0x53, 0x08, 0x48, 0x8b, 0x53,
+	0x38, 0x4a, 0x89, 0x44, 0x3a, 0x10, 0x48, 0x83, 0xf8, 0xff, 0x75, 0xc4, 0xff, 0x53, 0x30, 0x41,
+	0xbd, 0x05, 0x00, 0x00, 0x00, 0x48, 0x83, 0x7b, 0x40, 0x00, 0x44, 0x8b, 0x20, 0x44, 0x8b, 0x74,
+	0x24, 0x18, 0x0f, 0x85, 0xc8, 0x00, 0x00, 0x00, 0x48, 0x63, 0xed, 0xc4, 0xc1, 0x79, 0x6e, 0xd5,
+	0x4c, 0x8d, 0x7c, 0xad, 0x00, 0xc4, 0xc3, 0x69, 0x22, 0xcc, 0x01, 0x31, 0xed, 0xc4, 0xc1, 0xf9,
+	0x7e, 0xcc, 0x49, 0xc1, 0xe7, 0x03, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x48, 0x8b, 0x43, 0x38, 0x48, 0x01, 0xe8, 0x48, 0x83, 0xc5, 0x28, 0x48, 0x8b, 0x70, 0x08, 0x48,
+	0x8b, 0x78, 0x10, 0xff, 0x53, 0x10, 0x4c, 0x39, 0xfd, 0x75, 0xe5, 0x41, 0x83, 0xfe, 0xff, 0x74,
+	0x06, 0x44, 0x89, 0xf7, 0xff, 0x53, 0x18, 0x8b, 0x7b, 0x50, 0x83, 0xff, 0xff, 0x74, 0x0a, 0xff,
+	0x53, 0x18, 0xc7, 0x43, 0x50, 0xff, 0xff, 0xff, 0xff, 0x41, 0x83, 0xfd, 0x06, 0x74, 0x0b, 0x8b,
+	0x7b, 0x4c, 0x83, 0xff, 0xff, 0x74, 0x03, 0xff, 0x53, 0x18, 0x4c, 0x89, 0x23, 0x48, 0x83, 0xc4,
+	0x28, 0x5b, 0x5d, 0x41, 0x5c, 0x41, 0x5d, 0x41, 0x5e, 0x41, 0x5f, 0xc3, 0x0f, 0x1f, 0x40, 0x00,
+	0x8b, 0x7b, 0x50, 0x83, 0xff, 0xff, 0x74, 0x18, 0xff, 0x53, 0x18, 0xc7, 0x43, 0x50, 0xff, 0xff,
+	0xff, 0xff, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x1f, 0x00,
+	0x8b, 0x7b, 0x4c, 0x83, 0xff, 0xff, 0x74, 0x03, 0xff, 0x53, 0x18, 0xc7, 0x03, 0x03, 0x00, 0x00,
+	0x00, 0x89, 0x6b, 0x04, 0xeb, 0xb7, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x41, 0x83, 0xfc, 0x11, 0x41, 0xbd, 0x06, 0x00, 0x00, 0x00, 0x0f, 0x95, 0xc2, 0x31, 0xc0, 0x41,
+	0x83, 0xfc, 0x0c, 0x0f, 0x95, 0xc0, 0x21, 0xd0, 0x41, 0x29, 0xc5, 0xe9, 0x18, 0xff, 0xff, 0xff,
+	0x41, 0xbd, 0x28, 0x00, 0x00, 0x00, 0xeb, 0x13, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0xc5, 0x49, 0x83, 0xc5, 0x28, 0x39, 0x6b, 0x48, 0x7e, 0x4b, 0x4a, 0x8d, 0x04, 0x2a, 0x8b,
+	0x4c, 0x24, 0x0c, 0x45, 0x31, 0xc9, 0x41, 0xb8, 0xff, 0xff, 0xff, 0xff, 0x48, 0x8b, 0x38, 0x8b,
+	0x50, 0x18, 0x48, 0x8b, 0x70, 0x08, 0x4c, 0x01, 0xe7, 0xff, 0x53, 0x08, 0x48, 0x8b, 0x53, 0x38,
+	0x4a, 0x89, 0x44, 0x2a, 0x10, 0x48, 0x83, 0xf8, 0xff, 0x75, 0xc5, 0xe9, 0xac, 0xfe, 0xff, 0xff,
+	0x41, 0x83, 0xfe, 0xff, 0x74, 0x10, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x44, 0x89, 0xf7, 0xff, 0x53, 0x18, 0xc7, 0x03, 0x01, 0x00, 0x00, 0x00, 0x48, 0x83, 0xc4, 0x28,
+	0x5b, 0x5d, 0x41, 0x5c, 0x41, 0x5d, 0x41, 0x5e, 0x41, 0x5f, 0xc3, 0x0f, 0x1f, 0x44, 0x00, 0x00,
+	0x48, 0x63, 0x57, 0x48, 0x85, 0xd2, 0x0f, 0x8e, 0x10, 0x01, 0x00, 0x00, 0x48, 0x8b, 0x4f, 0x38,
+	0x48, 0x8d, 0x14, 0x92, 0x31, 0xed, 0x48, 0x8d, 0x41, 0x08, 0x48, 0x8d, 0x54, 0xd1, 0x08, 0x90,
+	0x48, 0x03, 0x28, 0x48, 0x83, 0xc0, 0x28, 0x48, 0x39, 0xc2, 0x75, 0xf4, 0x45, 0x31, 0xc9, 0x41,
+	0xb8, 0xff, 0xff, 0xff, 0xff, 0xb9, 0x02, 0x10, 0x00, 0x00, 0xba, 0x01, 0x00, 0x00, 0x00, 0x48,
+	0x89, 0xee, 0x31, 0xff, 0xff, 0x53, 0x08, 0x49, 0x89, 0xc4, 0x48, 0x83, 0xf8, 0xff, 0x0f, 0x84,
+	0xcf, 0x00, 0x00, 0x00, 0x48, 0x89, 0xee, 0x48, 0x89, 0xc7, 0x41, 0xbd, 0x11, 0x00, 0x00, 0x00,
+	0xff, 0x53, 0x10, 0xc7, 0x44, 0x24, 0x0c, 0x12, 0x10, 0x00, 0x00, 0xe9, 0x1c, 0xfd, 0xff, 0xff,
+	0xff, 0x53, 0x30, 0x48, 0x83, 0x7b, 0x40, 0x00, 0x8b, 0x28, 0x8b, 0x7c, 0x24, 0x18, 0x74, 0x40,
+	0x83, 0xfd, 0x11, 0x74, 0x05, 0x83, 0xfd, 0x0c, 0x75, 0x36, 0x83, 0xff, 0xff, 0x0f, 0x84, 0xc0,
+	0x00, 0x00, 0x00, 0xff, 0x53, 0x18, 0x8b, 0x7b, 0x50, 0x83, 0xff, 0xff, 0x74, 0x0a, 0xff, 0x53,
+	0x18, 0xc7, 0x43, 0x50, 0xff, 0xff, 0xff, 0xff, 0xb8, 0x06, 0x00, 0x00, 0x00, 0xc5, 0xf9, 0x6e,
+	0xc0, 0xeb, 0x3b, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x90,
+	0x83, 0xff, 0xff, 0x74, 0x4d, 0xff, 0x53, 0x18, 0x8b, 0x7b, 0x50, 0x83, 0xff, 0xff, 0x74, 0x0a,
+	0xff, 0x53, 0x18, 0xc7, 0x43, 0x50, 0xff, 0xff, 0xff, 0xff, 0x8b, 0x7b, 0x4c, 0x83, 0xff, 0xff,
+	0x74, 0x03, 0xff, 0x53, 0x18, 0xb8, 0x04, 0x00, 0x00, 0x00, 0xc5, 0xf9, 0x6e, 0xc0, 0xc4, 0xe3,
+	0x79, 0x22, 0xc5, 0x01, 0xc5, 0xf9, 0xd6, 0x03, 0xe9, 0x10, 0xfe, 0xff, 0xff, 0x0f, 0x1f, 0x00,
+	0xc7, 0x44, 0x24, 0x1c, 0xff, 0xff, 0xff, 0xff, 0xb8, 0xff, 0xff, 0xff, 0xff, 0xe9, 0xf9, 0xfc,
+	0xff, 0xff, 0x8b, 0x7b, 0x50, 0x83, 0xff, 0xff, 0x75, 0xb6, 0xeb, 0xbe, 0x31, 0xed, 0xe9, 0x09,
+	0xff, 0xff, 0xff, 0xff, 0x53, 0x30, 0x8b, 0x7b, 0x50, 0x8b, 0x28, 0x83, 0xff, 0xff, 0x74, 0x0a,
+	0xff, 0x53, 0x18, 0xc7, 0x43, 0x50, 0xff, 0xff, 0xff, 0xff, 0x8b, 0x7b, 0x4c, 0x83, 0xff, 0xff,
+	0x74, 0x03, 0xff, 0x53, 0x18, 0xc7, 0x03, 0x02, 0x00, 0x00, 0x00, 0x89, 0x6b, 0x04, 0xe9, 0xba,
+	0xfd, 0xff, 0xff, 0x8b, 0x7b, 0x50, 0x83, 0xff, 0xff, 0x0f, 0x85, 0x3f, 0xff, 0xff, 0xff, 0xe9,
+	0x44, 0xff, 0xff, 0xff
 };
 
 uint8_t KERNELRW_SHELLCODE[]{
-	0x41, 0x57, 0x41, 0x56, 0x41, 0x54, 0x53, 0x48, 0x83, 0xec, 0x18, 0x4c, 0x8b, 0x77, 0x18, 0x48,
-	0x89, 0xfb, 0xbf, 0x1c, 0x00, 0x00, 0x00, 0xbe, 0x02, 0x00, 0x00, 0x00, 0xba, 0x11, 0x00, 0x00,
-	0x00, 0x41, 0xff, 0xd6, 0x4c, 0x8b, 0x7b, 0x08, 0xbf, 0x1c, 0x00, 0x00, 0x00, 0xbe, 0x02, 0x00,
-	0x00, 0x00, 0xba, 0x11, 0x00, 0x00, 0x00, 0x41, 0x89, 0x07, 0x41, 0xff, 0xd6, 0x49, 0x8d, 0x7f,
-	0x08, 0x41, 0x89, 0x47, 0x04, 0xff, 0x53, 0x20, 0x83, 0xf8, 0xff, 0x0f, 0x84, 0xb8, 0x00, 0x00,
-	0x00, 0xc7, 0x04, 0x24, 0x14, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x04, 0x29, 0x00, 0x00, 0x00,
-	0xc7, 0x44, 0x24, 0x08, 0x3d, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x0c, 0x00, 0x00, 0x00, 0x00,
-	0xc7, 0x44, 0x24, 0x10, 0x00, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x14, 0x00, 0x00, 0x00, 0x00,
-	0x49, 0x89, 0xe6, 0xbe, 0x29, 0x00, 0x00, 0x00, 0xba, 0x19, 0x00, 0x00, 0x00, 0x41, 0xb8, 0x18,
-	0x00, 0x00, 0x00, 0x4c, 0x8b, 0x63, 0x28, 0x41, 0x8b, 0x3f, 0x4c, 0x89, 0xf1, 0x41, 0xff, 0xd4,
-	0xc7, 0x04, 0x24, 0x00, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x04, 0x00, 0x00, 0x00, 0x00, 0xc7,
-	0x44, 0x24, 0x08, 0x00, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x0c, 0x00, 0x00, 0x00, 0x00, 0xc7,
-	0x44, 0x24, 0x10, 0x00, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x14, 0x00, 0x00, 0x00, 0x00, 0xbe,
-	0x29, 0x00, 0x00, 0x00, 0xba, 0x2e, 0x00, 0x00, 0x00, 0x4c, 0x89, 0xf1, 0x41, 0xb8, 0x14, 0x00,
-	0x00, 0x00, 0x41, 0x8b, 0x7f, 0x04, 0x41, 0xff, 0xd4, 0xc7, 0x03, 0x01, 0x00, 0x00, 0x00, 0x48,
-	0x8b, 0x5b, 0x10, 0x66, 0x66, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0xd3, 0xeb, 0xf7, 0xff, 0x53, 0x30, 0x8b, 0x00, 0x89, 0x43,
-	0x04, 0xe9, 0x3b, 0xff, 0xff, 0xff
+	0x55, 0x53, 0x48, 0x89, 0xfb, 0xba, 0x11, 0x00, 0x00, 0x00, 0x48, 0x83, 0xec, 0x28, 0x48, 0x8b,
+	0x6f, 0x08, 0xbe, 0x02, 0x00, 0x00, 0x00, 0xbf, 0x1c, 0x00, 0x00, 0x00, 0xff, 0x53, 0x10, 0xbf,
+	0x1c, 0x00, 0x00, 0x00, 0xba, 0x11, 0x00, 0x00, 0x00, 0xbe, 0x02, 0x00, 0x00, 0x00, 0x89, 0x45,
+	0x00, 0x48, 0x8b, 0x6b, 0x08, 0xff, 0x53, 0x10, 0x89, 0x45, 0x04, 0x48, 0x8b, 0x43, 0x08, 0x48,
+	0x8d, 0x78, 0x08, 0xff, 0x53, 0x18, 0x83, 0xf8, 0xff, 0x0f, 0x84, 0xb1, 0x00, 0x00, 0x00, 0x48,
+	0x8b, 0x43, 0x08, 0x48, 0x89, 0xe5, 0xc7, 0x04, 0x24, 0x14, 0x00, 0x00, 0x00, 0x41, 0xb8, 0x18,
+	0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x04, 0x29, 0x00, 0x00, 0x00, 0x48, 0x89, 0xe9, 0xc7, 0x44,
+	0x24, 0x08, 0x3d, 0x00, 0x00, 0x00, 0xba, 0x19, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x0c, 0x00,
+	0x00, 0x00, 0x00, 0xbe, 0x29, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x10, 0x00, 0x00, 0x00, 0x00,
+	0xc7, 0x44, 0x24, 0x14, 0x00, 0x00, 0x00, 0x00, 0x8b, 0x38, 0xff, 0x53, 0x20, 0xc7, 0x04, 0x24,
+	0x00, 0x00, 0x00, 0x00, 0x48, 0x89, 0xe9, 0x48, 0x8b, 0x43, 0x08, 0xc7, 0x44, 0x24, 0x04, 0x00,
+	0x00, 0x00, 0x00, 0x41, 0xb8, 0x14, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x08, 0x00, 0x00, 0x00,
+	0x00, 0xba, 0x2e, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x0c, 0x00, 0x00, 0x00, 0x00, 0xbe, 0x29,
+	0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x10, 0x00, 0x00, 0x00, 0x00, 0xc7, 0x44, 0x24, 0x14, 0x00,
+	0x00, 0x00, 0x00, 0x8b, 0x78, 0x04, 0xff, 0x53, 0x20, 0xc7, 0x03, 0x01, 0x00, 0x00, 0x00, 0x48,
+	0x83, 0xc4, 0x28, 0x5b, 0x5d, 0xc3, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xff, 0x53, 0x28, 0x8b, 0x00, 0x89, 0x43, 0x04, 0xe9, 0x42, 0xff, 0xff, 0xff
+};
+
+// see shellcode/resolver.cpp for source
+uint8_t RESOLVER_SHELLCODE[]{
+	0x41, 0x56, 0x41, 0x55, 0x41, 0x54, 0x45, 0x31, 0xf6, 0x55, 0x53, 0x48, 0x89, 0xfd, 0x48, 0x83,
+	0xec, 0x10, 0x8b, 0x57, 0x34, 0x4c, 0x8d, 0x6c, 0x24, 0x08, 0x85, 0xd2, 0x0f, 0x8e, 0x93, 0x00,
+	0x00, 0x00, 0x66, 0x66, 0x2e, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x1f, 0x00,
+	0x48, 0x8b, 0x45, 0x20, 0x48, 0xc7, 0x44, 0x24, 0x08, 0x00, 0x00, 0x00, 0x00, 0x46, 0x8b, 0x24,
+	0xb0, 0x8b, 0x45, 0x30, 0x4c, 0x03, 0x65, 0x10, 0x85, 0xc0, 0x7e, 0x33, 0x31, 0xdb, 0x66, 0x90,
+	0x48, 0x8b, 0x45, 0x18, 0x4c, 0x89, 0xea, 0x4c, 0x89, 0xe6, 0x8b, 0x3c, 0x98, 0xff, 0x55, 0x08,
+	0x85, 0xc0, 0x75, 0x0a, 0x48, 0x8b, 0x44, 0x24, 0x08, 0x48, 0x85, 0xc0, 0x75, 0x32, 0x48, 0xc7,
+	0x44, 0x24, 0x08, 0x00, 0x00, 0x00, 0x00, 0x48, 0xff, 0xc3, 0x39, 0x5d, 0x30, 0x7f, 0xd1, 0xc7,
+	0x45, 0x00, 0x02, 0x00, 0x00, 0x00, 0x44, 0x89, 0x75, 0x04, 0x48, 0x83, 0xc4, 0x10, 0x5b, 0x5d,
+	0x41, 0x5c, 0x41, 0x5d, 0x41, 0x5e, 0xc3, 0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x48, 0x8b, 0x55, 0x28, 0x4a, 0x89, 0x04, 0xf2, 0x49, 0xff, 0xc6, 0x44, 0x39, 0x75, 0x34, 0x0f,
+	0x8f, 0x7b, 0xff, 0xff, 0xff, 0xc7, 0x45, 0x00, 0x01, 0x00, 0x00, 0x00, 0x48, 0x83, 0xc4, 0x10,
+	0x5b, 0x5d, 0x41, 0x5c, 0x41, 0x5d, 0x41, 0x5e, 0xc3
 };
 
 }
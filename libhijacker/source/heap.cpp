@@ -0,0 +1,161 @@
+#include "hijacker/heap.hpp"
+#include "util.hpp"
+
+extern "C" {
+	#include <stdint.h>
+	#include <stdio.h>
+}
+
+RemoteAllocation &RemoteAllocation::operator=(RemoteAllocation &&rhs) {
+	if (this != &rhs) {
+		if (heap != nullptr && addr != 0) {
+			heap->free(addr);
+		}
+		heap = rhs.heap;
+		addr = rhs.addr;
+		rhs.heap = nullptr;
+		rhs.addr = 0;
+	}
+	return *this;
+}
+
+RemoteAllocation::~RemoteAllocation() {
+	if (heap != nullptr && addr != 0) {
+		heap->free(addr);
+	}
+}
+
+RemoteHeap::RemoteHeap(uintptr_t base, size_t capacity) :
+		base(base), capacity(capacity & ~(ALIGNMENT - 1)), used(), blocks(), bins() {
+	blocks = new Block{base, this->capacity, nullptr, nullptr, nullptr, nullptr, false};
+	insertFree(blocks);
+}
+
+RemoteHeap::~RemoteHeap() {
+	Block *block = blocks;
+	while (block != nullptr) {
+		Block *next = block->next;
+		delete block;
+		block = next;
+	}
+}
+
+void RemoteHeap::insertFree(Block *block) {
+	Block *&head = bins[sizeClass(block->size)];
+	block->free = true;
+	block->prevFree = nullptr;
+	block->nextFree = head;
+	if (head != nullptr) {
+		head->prevFree = block;
+	}
+	head = block;
+}
+
+void RemoteHeap::removeFree(Block *block) {
+	if (block->prevFree != nullptr) {
+		block->prevFree->nextFree = block->nextFree;
+	} else {
+		bins[sizeClass(block->size)] = block->nextFree;
+	}
+	if (block->nextFree != nullptr) {
+		block->nextFree->prevFree = block->prevFree;
+	}
+	block->free = false;
+	block->prevFree = nullptr;
+	block->nextFree = nullptr;
+}
+
+RemoteHeap::Block *RemoteHeap::find(uintptr_t addr) const {
+	for (Block *block = blocks; block != nullptr; block = block->next) {
+		if (block->addr == addr) {
+			return block;
+		}
+		if (block->addr > addr) {
+			break;
+		}
+	}
+	return nullptr;
+}
+
+uintptr_t RemoteHeap::allocate(size_t size) {
+	if (size == 0) [[unlikely]] {
+		size = ALIGNMENT;
+	}
+	if ((size & (ALIGNMENT - 1)) != 0) {
+		size = (size & ~(ALIGNMENT - 1)) + ALIGNMENT;
+	}
+	if (size > capacity - used) [[unlikely]] {
+		return 0;
+	}
+
+	// the blocks in the first class may still be too small
+	// every block in a larger class is big enough
+	Block *block = nullptr;
+	for (size_t c = sizeClass(size); c < NUM_CLASSES && block == nullptr; c++) {
+		for (Block *it = bins[c]; it != nullptr; it = it->nextFree) {
+			if (it->size >= size) {
+				block = it;
+				break;
+			}
+		}
+	}
+
+	if (block == nullptr) [[unlikely]] {
+		// too fragmented
+		return 0;
+	}
+
+	removeFree(block);
+
+	if (block->size - size >= ALIGNMENT) {
+		Block *rest = new Block{block->addr + size, block->size - size, block, block->next, nullptr, nullptr, false};
+		if (block->next != nullptr) {
+			block->next->prev = rest;
+		}
+		block->next = rest;
+		block->size = size;
+		insertFree(rest);
+	}
+
+	used += block->size;
+	return block->addr;
+}
+
+void RemoteHeap::free(uintptr_t addr) {
+	Block *block = find(addr);
+	if (block == nullptr || block->free) [[unlikely]] {
+		#ifdef DEBUG
+		fatalf("invalid free of 0x%llx\n", (unsigned long long) addr);
+		#else
+		printf("invalid free of 0x%llx\n", (unsigned long long) addr);
+		return;
+		#endif
+	}
+
+	used -= block->size;
+
+	Block *next = block->next;
+	if (next != nullptr && next->free) {
+		removeFree(next);
+		block->size += next->size;
+		block->next = next->next;
+		if (next->next != nullptr) {
+			next->next->prev = block;
+		}
+		delete next;
+	}
+
+	Block *prev = block->prev;
+	if (prev != nullptr && prev->free) {
+		removeFree(prev);
+		prev->size += block->size;
+		prev->next = block->next;
+		if (block->next != nullptr) {
+			block->next->prev = prev;
+		}
+		delete block;
+		block = prev;
+	}
+
+	insertFree(block);
+}
@@ -1,15 +1,44 @@
 #include "hijacker.hpp"
 #include "offsets.hpp"
 #include "util.hpp"
+#include "wait.hpp"
 #include <ps5/kernel.h>
 
 extern "C" {
 #include <stdint.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+int usleep(unsigned int useconds);
+}
+
+#ifndef SHM_ANON
+#define SHM_ANON ((char *)1)
+#endif
+
+#ifndef MAP_EXCL
+#define MAP_EXCL 0x4000
+#endif
+
+static constexpr size_t MAX_THREADS = 0x400;
+
+static constinit WaitSite stateWait{"Hijacker::waitForState"};
+
+namespace nid {
+
+static inline constexpr Nid mmap{"BPE9s9vQQXo"};
+static inline constexpr Nid munmap{"UqDGjXA5yUM"};
+static inline constexpr Nid socket{"TU-d9PfIHPM"};
+
 }
 
 UniquePtr<Hijacker> Hijacker::getHijacker(const StringView &processName) {
 	UniquePtr<SharedObject> obj = nullptr;
+	dbg::Session session{};
 	for (dbg::ProcessInfo info : dbg::getProcesses()) {
 		if (info.name() == processName) {
 			auto p = ::getProc(info.pid());
@@ -21,6 +50,7 @@ UniquePtr<Hijacker> Hijacker::getHijacker(const StringView &processName) {
 
 int Hijacker::getMainThreadId() {
 	if (mainThreadId == -1) {
+		dbg::Session session{};
 		for (dbg::ThreadInfo info : dbg::getThreads(obj->pid)) {
 			StringView name = info.name();
 			if (name.contains("Main") || name.contains(".")) {
@@ -33,9 +63,45 @@ int Hijacker::getMainThreadId() {
 	return mainThreadId;
 }
 
+bool Hijacker::isTrapFrameCacheValid() {
+	if (cachedThread == 0) {
+		return false;
+	}
+
+	// the proc may have been freed and reused by another process
+	if (kread<int>(cachedProc + KProc::PID_OFFSET) != obj->pid) [[unlikely]] {
+		return false;
+	}
+
+	// only the links are read, the main thread is almost always the first one
+	bool found = false;
+	uintptr_t td = kread<uintptr_t>(cachedProc + KProc::THREADS_OFFSET);
+	for (size_t i = 0; td != 0 && i < MAX_THREADS; i++) {
+		if (td == cachedThread) {
+			found = true;
+			break;
+		}
+		td = kread<uintptr_t>(td);
+	}
+	if (!found) [[unlikely]] {
+		return false;
+	}
+
+	// the thread may have exited and its memory reused for a new one
+	if (kread<int>(cachedThread + KThread::TID_OFFSET) != mainThreadId) [[unlikely]] {
+		return false;
+	}
+	return kread<uintptr_t>(cachedThread + KThread::FRAME_OFFSET) == cachedFrame;
+}
+
 UniquePtr<TrapFrame> Hijacker::getTrapFrame() {
-	// do not cache this
+	// the frame contents are always reread since they change whenever the thread is scheduled
 	int tid = getMainThreadId();
+	if (isTrapFrameCacheValid()) [[likely]] {
+		return new TrapFrame(cachedFrame);
+	}
+
+	invalidateTrapFrameCache();
 	auto p = ::getProc(obj->pid);
 	if (p == nullptr) {
 		return nullptr;
@@ -45,7 +111,226 @@ UniquePtr<TrapFrame> Hijacker::getTrapFrame() {
 	if (td == nullptr) {
 		return nullptr;
 	}
-	return td->getFrame();
+
+	const uintptr_t frame = td->td_frame();
+	if (frame == 0) [[unlikely]] {
+		return nullptr;
+	}
+	cachedProc = p->address();
+	cachedThread = td->address();
+	cachedFrame = frame;
+	return new TrapFrame(frame);
+}
+
+Hijacker::~Hijacker() {
+	// the main thread has to leave the agent before the mailbox holding its queue is unmapped
+	agent = nullptr;
+	releaseScratch();
+	if (dataAllocated || (heap == nullptr && mailbox == nullptr) || !isAlive()) {
+		// a payload may still be using the heap
+		return;
+	}
+
+	const uintptr_t fn = getLibKernelFunctionAddress(nid::munmap);
+	if (heap != nullptr) {
+		UniquePtr<RemoteHeap> region{heap.release()};
+		heapFailed = true;
+		if (call<int>(fn, region->address(), region->getCapacity()) != 0) [[unlikely]] {
+			printf("failed to unmap the remote heap: %s\n", strerror(lastCallError));
+		}
+	}
+	if (mailbox != nullptr) {
+		// detached first so that the scratch memory for the call comes from elsewhere
+		UniquePtr<Mailbox> region{mailbox.release()};
+		mailboxFailed = true;
+		if (call<int>(fn, region->address(), Mailbox::LENGTH) != 0) [[unlikely]] {
+			printf("failed to unmap the mailbox: %s\n", strerror(lastCallError));
+		}
+	}
+}
+
+Mailbox *Hijacker::getMailbox() {
+	if (mailbox == nullptr && !mailboxFailed) [[unlikely]] {
+		// creating it calls into the target which needs scratch memory from somewhere else
+		mailboxFailed = true;
+		mailbox = Mailbox::create(*this);
+		// don't keep hijacking the process if it didn't work the first time
+		mailboxFailed = mailbox == nullptr;
+	}
+	return mailbox.get();
+}
+
+Agent *Hijacker::getAgent() {
+	if (agent == nullptr && !agentFailed) [[unlikely]] {
+		agent = Agent::create(*this);
+		agentFailed = agent == nullptr;
+	}
+	return getRunningAgent();
+}
+
+RemoteHeap *Hijacker::getHeap() {
+	if (heap == nullptr && !heapFailed) [[unlikely]] {
+		// don't try again if it didn't work the first time
+		heapFailed = true;
+		const uintptr_t fn = getLibKernelFunctionAddress(nid::mmap);
+		// MAP_EXCL makes the mmap fail instead of replacing anything mapped since the map was read
+		const uintptr_t hint = findFreeRegion(RemoteHeap::DEFAULT_CAPACITY, 0x4000);
+		const int flags = hint != 0 ? MAP_ANON | MAP_PRIVATE | MAP_FIXED | MAP_EXCL : MAP_ANON | MAP_PRIVATE;
+		auto addr = call<intptr_t>(fn, hint, RemoteHeap::DEFAULT_CAPACITY, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (addr == -1 && hint != 0 && lastCallError != -1) {
+			// lost the race for the range, let the kernel pick
+			addr = call<intptr_t>(fn, 0, RemoteHeap::DEFAULT_CAPACITY, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+		}
+		if (addr == -1 || addr == 0) [[unlikely]] {
+			printf("failed to reserve the remote heap: %s\n", strerror(lastCallError));
+			return nullptr;
+		}
+		heap = new RemoteHeap(addr, RemoteHeap::DEFAULT_CAPACITY);
+		heapFailed = false;
+	}
+	return heap.get();
+}
+
+uintptr_t Hijacker::allocateData(size_t size) {
+	dataAllocated = true;
+	RemoteHeap *h = getHeap();
+	const uintptr_t addr = h != nullptr ? h->allocate(size) : 0;
+	return addr != 0 ? addr : dataAllocator.allocate(size);
+}
+
+uintptr_t Hijacker::allocateScratch(size_t size) {
+	Mailbox *mb = getMailbox();
+	uintptr_t addr = mb != nullptr ? mb->allocate(size) : 0;
+	if (addr != 0) [[likely]] {
+		return addr;
+	}
+
+	// the heap isn't created here since doing so requires scratch memory
+	if (heap != nullptr && numScratchAllocations < MAX_SCRATCH_ALLOCATIONS) {
+		addr = heap->allocate(size);
+		if (addr != 0) [[likely]] {
+			scratchAllocations[numScratchAllocations++] = addr;
+			return addr;
+		}
+	}
+	return dataAllocator.allocate(size);
+}
+
+int32_t Hijacker::pollState(uintptr_t addr, uint32_t maxSleeps) {
+	if (mailbox != nullptr && mailbox->contains(addr, sizeof(int32_t))) [[likely]] {
+		auto *state = static_cast<volatile int32_t *>(mailbox->toLocal(addr));
+		return Mailbox::wait(state, Mailbox::DEFAULT_SPINS, Mailbox::DEFAULT_SLEEP, maxSleeps);
+	}
+	usleep(Mailbox::DEFAULT_SLEEP);
+	return read<int32_t>(addr);
+}
+
+bool Hijacker::waitForState(uintptr_t addr, int32_t &state) {
+	// the liveness check is an mdbg call so only do it between longer waits
+	static constexpr uint32_t SLEEPS_PER_CHECK = 0x1000;
+	bool alive = true;
+	waitUntil(stateWait, [&]() {
+		state = pollState(addr, SLEEPS_PER_CHECK);
+		if (state != 0) [[likely]] {
+			return true;
+		}
+		alive = isAlive();
+		return !alive;
+	}, Deadline::never(), BackoffPolicy::blocking());
+	return alive;
+}
+
+int Hijacker::shareFile(int fd) {
+	auto tbl = ::getProc()->getFdTbl();
+	const uintptr_t file = tbl.getFile(fd);
+	if (file == 0) [[unlikely]] {
+		return -1;
+	}
+
+	// the target opens the placeholder itself so that its fd_map reserves the slot
+	const uintptr_t fn = getLibKernelFunctionAddress(nid::socket);
+	const int remoteFd = call<int>(fn, AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (remoteFd < 0) [[unlikely]] {
+		printf("failed to open a placeholder descriptor: %s\n", strerror(lastCallError));
+		return -1;
+	}
+
+	// swap the files so that each table still owns exactly one reference to what it holds
+	// the target must not be running while its table entry changes under it
+	const bool wasRunning = isMainThreadRunning;
+	suspend();
+	auto remoteTbl = getProc()->getFdTbl();
+	const uintptr_t placeholder = remoteTbl.getFile(remoteFd);
+	remoteTbl.setFile(remoteFd, file);
+	tbl.setFile(fd, placeholder);
+	if (wasRunning) {
+		resume();
+	}
+
+	// our descriptor now refers to the placeholder
+	close(fd);
+	return remoteFd;
+}
+
+void *Hijacker::mapRemoteFile(int fd, size_t length, int prot) {
+	auto remoteTbl = getProc()->getFdTbl();
+	const uintptr_t file = remoteTbl.getFile(fd);
+	if (file == 0) [[unlikely]] {
+		return nullptr;
+	}
+
+	// a real descriptor is needed so that the slot is marked as used
+	const int placeholder = shm_open(SHM_ANON, O_RDWR, 0600);
+	if (placeholder == -1) [[unlikely]] {
+		return nullptr;
+	}
+
+	// borrow the file for the duration of the mmap
+	// both tables keep their own reference so the counts never change
+	auto tbl = ::getProc()->getFdTbl();
+	const uintptr_t original = tbl.getFile(placeholder);
+	tbl.setFile(placeholder, file);
+	void *local = mmap(nullptr, length, prot, MAP_SHARED, placeholder, 0);
+	tbl.setFile(placeholder, original);
+	close(placeholder);
+
+	return local != MAP_FAILED ? local : nullptr;
+}
+
+size_t Hijacker::readv(const dbg::ReadOp *ops, size_t n, int *errors) {
+	if (mailbox == nullptr) {
+		return dbg::readv(getPid(), ops, n, errors);
+	}
+
+	// service the ops in the mailbox locally and forward the rest
+	UniquePtr<dbg::ReadOp[]> remote{new dbg::ReadOp[n]};
+	UniquePtr<size_t[]> indices{new size_t[n]};
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++) {
+		const dbg::ReadOp &op = ops[i];
+		if (mailbox->contains(op.src, op.length)) {
+			__builtin_memcpy(op.dst, mailbox->toLocal(op.src), op.length);
+			if (errors != nullptr) {
+				errors[i] = 0;
+			}
+			continue;
+		}
+		indices[count] = i;
+		remote[count++] = op;
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	UniquePtr<int[]> remoteErrors{new int[count]};
+	const size_t failed = dbg::readv(getPid(), remote.get(), count, remoteErrors.get());
+	if (errors != nullptr) {
+		for (size_t i = 0; i < count; i++) {
+			errors[indices[i]] = remoteErrors[i];
+		}
+	}
+	return failed;
 }
 
 static inline void copyin(uintptr_t kdst, const void *src, size_t length) {
@@ -54,31 +339,28 @@ static inline void copyin(uintptr_t kdst, const void *src, size_t length) {
 
 void Hijacker::jailbreak() const {
 	auto p = getProc();
-	uintptr_t ucred = p->p_ucred();
 	uintptr_t fd = p->p_fd();
-	UniquePtr<uint8_t[]> rootvnode_area_store{new uint8_t[0x100]};
-	kernel_copyout(kernel_base + offsets::root_vnode(), rootvnode_area_store.get(), 0x100);
-	uint32_t uid_store = 0;
-	uint32_t ngroups_store = 0;
-	uint64_t authid_store = 0x4801000000000013l;
-	int64_t caps_store = -1;
-	uint8_t attr_store[] = {0x80, 0, 0, 0, 0, 0, 0, 0};
-
-	copyin(ucred + 0x04, &uid_store, 0x4);		  // cr_uid
-	copyin(ucred + 0x08, &uid_store, 0x4);		  // cr_ruid
-	copyin(ucred + 0x0C, &uid_store, 0x4);		  // cr_svuid
-	copyin(ucred + 0x10, &ngroups_store, 0x4);	  // cr_ngroups
-	copyin(ucred + 0x14, &uid_store, 0x4);		  // cr_rgid
+	const uintptr_t rootvnode = kread<uintptr_t>(kernel_base + offsets::root_vnode());
+
+	// one read and three writes, the ids and the sony fields are each contiguous
+	modify<KUcred>(p->p_ucred(), [](KUcred &cred) {
+		cred.uid(0);
+		cred.ruid(0);
+		cred.svuid(0);
+		cred.ngroups(0);
+		cred.rgid(0);
+
+		// Escalate sony privileges
+		cred.authid(0x4801000000000013l);
+		cred.caps(0, -1);
+		cred.caps(1, -1);
+		cred.attr(0x80);
+	});
 
 	// Escape sandbox
-	copyin(fd + 0x10, rootvnode_area_store.get(), 0x8);  // fd_rdir
-	copyin(fd + 0x18, rootvnode_area_store.get(), 0x8);  // fd_jdir
-
-	// Escalate sony privileges
-	copyin(ucred + 0x58, &authid_store, 0x8);	 // cr_sceAuthID
-	copyin(ucred + 0x60, &caps_store, 0x8);		 // cr_sceCaps[0]
-	copyin(ucred + 0x68, &caps_store, 0x8);		 // cr_sceCaps[1]
-	copyin(ucred + 0x83, attr_store, 0x1);		 // cr_sceAttr[0]
+	const uintptr_t dirs[] = {rootvnode, rootvnode};
+	static_assert(layout::STRUCTS.filedesc.jdir == layout::STRUCTS.filedesc.rdir + sizeof(uintptr_t));
+	copyin(fd + layout::STRUCTS.filedesc.rdir, dirs, sizeof(dirs)); // fd_rdir and fd_jdir
 }
 
 uintptr_t Hijacker::getFunctionAddress(SharedLib *lib, const Nid &fname) const {
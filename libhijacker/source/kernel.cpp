@@ -1,28 +1,158 @@
 #include "kernel.hpp"
 #include "util.hpp"
+#include <immintrin.h>
 
 extern "C" {
 	#include <ps5/kernel.h>
 }
 
+static constexpr size_t STRING_WINDOW = 0x100;
+static constexpr size_t KERNEL_PAGE_SIZE = 0x1000;
+static constexpr size_t STRING_CACHE_SIZE = 64;
+
+// plain pointers so that the table needs no constructor
+struct KernelStringCacheEntry {
+	uintptr_t addr;
+	String *value;
+};
+
+static KernelStringCacheEntry stringCache[STRING_CACHE_SIZE];
+static int stringCacheLock;
+
+static size_t findNul(const char *buf, size_t length) {
+	size_t i = 0;
+	const __m256i zero = _mm256_setzero_si256();
+	for (; i + sizeof(__m256i) <= length; i += sizeof(__m256i)) {
+		const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buf + i));
+		const uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, zero));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	for (; i < length; i++) {
+		if (buf[i] == '\0') {
+			return i;
+		}
+	}
+	return length;
+}
+
 String getKernelString(uintptr_t addr) {
 	String res{};
-	char buf[0x10];
+	alignas(32) char buf[STRING_WINDOW];
 	while (true) {
-		kernel_copyout(addr + res.length(), buf, sizeof(buf));
-		size_t read = strnlen(buf, sizeof(buf));
+		// never read past the page the string is in since the next one may not be mapped
+		const uintptr_t src = addr + res.length();
+		const size_t remaining = KERNEL_PAGE_SIZE - (src & (KERNEL_PAGE_SIZE - 1));
+		const size_t length = remaining < sizeof(buf) ? remaining : sizeof(buf);
+		kernel_copyout(src, buf, length);
+		const size_t read = findNul(buf, length);
 		res += StringView{buf, read};
-		if (read < sizeof(buf)) {
+		if (read < length) {
+			return res;
+		}
+	}
+}
+
+static size_t stringCacheIndex(uintptr_t addr) {
+	return ((addr >> 4) ^ (addr >> 12)) & (STRING_CACHE_SIZE - 1);
+}
+
+// the memory may have been freed and reused since the string was cached
+// so a hit is only trusted if the part of it which fits in one read is still there
+static bool stillInterned(uintptr_t addr, const String &value) {
+	alignas(32) char buf[STRING_WINDOW];
+	const size_t remaining = KERNEL_PAGE_SIZE - (addr & (KERNEL_PAGE_SIZE - 1));
+	const size_t window = remaining < sizeof(buf) ? remaining : sizeof(buf);
+	// the terminator is compared too when it fits so that a shorter or longer string is caught
+	const size_t length = value.length() < window ? value.length() + 1 : window;
+	kernel_copyout(addr, buf, length);
+	return __builtin_memcmp(buf, value.c_str(), length) == 0;
+}
+
+String getInternedKernelString(uintptr_t addr) {
+	KernelStringCacheEntry &entry = stringCache[stringCacheIndex(addr)];
+	while (__atomic_exchange_n(&stringCacheLock, 1, __ATOMIC_ACQUIRE)) {
+		__builtin_ia32_pause();
+	}
+	if (entry.addr == addr && entry.value != nullptr) [[likely]] {
+		String res{*entry.value};
+		__atomic_store_n(&stringCacheLock, 0, __ATOMIC_RELEASE);
+		if (stillInterned(addr, res)) [[likely]] {
 			return res;
 		}
+	} else {
+		__atomic_store_n(&stringCacheLock, 0, __ATOMIC_RELEASE);
+	}
+
+	// read without the lock, the last writer wins if two threads miss at once
+	String res = getKernelString(addr);
+	String *value = new String(res);
+	while (__atomic_exchange_n(&stringCacheLock, 1, __ATOMIC_ACQUIRE)) {
+		__builtin_ia32_pause();
 	}
+	delete entry.value;
+	entry.addr = addr;
+	entry.value = value;
+	__atomic_store_n(&stringCacheLock, 0, __ATOMIC_RELEASE);
+	return res;
+}
+
+void clearKernelStringCache() {
+	while (__atomic_exchange_n(&stringCacheLock, 1, __ATOMIC_ACQUIRE)) {
+		__builtin_ia32_pause();
+	}
+	for (KernelStringCacheEntry &entry : stringCache) {
+		delete entry.value;
+		entry.addr = 0;
+		entry.value = nullptr;
+	}
+	__atomic_store_n(&stringCacheLock, 0, __ATOMIC_RELEASE);
 }
 
 UniquePtr<KProc> getProc(int pid) {
-	for (auto p : getAllProcs()) {
-		if (pid == p->pid()) {
-			return p.release();
+	constexpr size_t prefix = KProc::PID_OFFSET + sizeof(int);
+	const uintptr_t p = getAllProcs().prefetch<prefix>().find([pid](const KNode<KProc, prefix> &node) {
+		return node.get<int, KProc::PID_OFFSET>() == pid;
+	});
+	return p != 0 ? new KProc{p} : nullptr;
+}
+
+Array<FdEntry> FdTbl::snapshot(size_t begin, size_t end) const {
+	if (end > ntables) {
+		end = ntables;
+	}
+	if (begin >= end) [[unlikely]] {
+		return nullptr;
+	}
+
+	const size_t n = end - begin;
+	UniquePtr<uint8_t[]> descents{new uint8_t[n * Filedescent::length]};
+	kernel_copyout(addr + (begin * Filedescent::length) + sizeof(ntables), descents.get(), n * Filedescent::length);
+
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (*(uintptr_t *)(descents.get() + i * Filedescent::length) != 0) {
+			count++;
 		}
 	}
-	return nullptr;
+	if (count == 0) {
+		return nullptr;
+	}
+
+	Array<FdEntry> entries{count};
+	UniquePtr<kernel_readop[]> ops{new kernel_readop[count]};
+	for (size_t i = 0, j = 0; i < n; i++) {
+		const uint8_t *descent = descents.get() + i * Filedescent::length;
+		const uintptr_t file = *(uintptr_t *)descent;
+		if (file == 0) {
+			continue;
+		}
+		entries[j] = {(int)(begin + i), descent[Filedescent::FLAGS_OFFSET], file, 0};
+		ops[j] = {file, &entries[j].data, sizeof(uintptr_t)};
+		j++;
+	}
+
+	kreadv(ops.get(), count);
+	return entries;
 }
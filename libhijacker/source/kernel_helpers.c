@@ -5,6 +5,7 @@
  ****************************************************/
 
 #include <ps5/kernel.h>
+#include "kernel_helpers.h"
 
 #include <stdint.h>
 #include <sys/socket.h>
@@ -18,6 +19,22 @@ int _victim_sock;
 int _rw_pipe[2];
 uint64_t _pipe_addr;
 
+// the primitive is a single pipe so only one thread may use it at a time
+static int _rw_lock;
+
+static void lock_rw(void) {
+	while (__atomic_exchange_n(&_rw_lock, 1, __ATOMIC_ACQUIRE)) {
+		__builtin_ia32_pause();
+	}
+}
+
+static void unlock_rw(void) {
+	__atomic_store_n(&_rw_lock, 0, __ATOMIC_RELEASE);
+}
+
+// the size and count the pipe is given for reads
+#define PIPE_SIZE 0x40000000
+
 extern size_t _write(int fd, const void *buf, size_t nbyte);
 extern size_t _read(int fd, void *buf, size_t nbyte);
 
@@ -48,6 +65,8 @@ void kernel_copyin(void *src, uint64_t kdest, size_t length)
 {
 	uint64_t write_buf[3];
 
+	lock_rw();
+
 	// Set pipe flags
 	write_buf[0] = 0;
 	write_buf[1] = 0x4000000000000000;
@@ -62,6 +81,8 @@ void kernel_copyin(void *src, uint64_t kdest, size_t length)
 
 	// Perform write across pipe
 	_write(_rw_pipe[1], src, length);
+
+	unlock_rw();
 }
 
 // Public API function to read kernel data.
@@ -69,6 +90,8 @@ void kernel_copyout(uint64_t ksrc, void *dest, size_t length)
 {
 	uint64_t write_buf[3];
 
+	lock_rw();
+
 	// Set pipe flags
 	write_buf[0] = 0x4000000040000000;
 	write_buf[1] = 0x4000000000000000;
@@ -83,4 +106,50 @@ void kernel_copyout(uint64_t ksrc, void *dest, size_t length)
 
 	// Perform read across pipe
 	_read(_rw_pipe[0], dest, length);
+
+	unlock_rw();
+}
+
+// The pipe reads from buffer + out and advances out by the length read, so after the
+// flags are set once each range only needs the data addr moved, and none if it follows
+// the previous range.
+void kernel_copyoutv(const struct kernel_readop *ops, size_t n)
+{
+	uint64_t write_buf[3];
+	uint64_t out = PIPE_SIZE;
+	uint64_t next = 0;
+
+	lock_rw();
+
+	for (size_t i = 0; i < n; i++) {
+		const struct kernel_readop *op = &ops[i];
+		if (op->ksrc == 0 || op->length == 0) {
+			continue;
+		}
+
+		if (out + op->length >= PIPE_SIZE) {
+			// Set pipe flags
+			write_buf[0] = 0x4000000040000000;
+			write_buf[1] = 0x4000000000000000;
+			write_buf[2] = 0;
+			kwrite(_pipe_addr, (uint64_t *) &write_buf);
+			out = 0;
+			next = 0;
+		}
+
+		if (op->ksrc != next) {
+			// Set pipe data addr so that buffer + out is the source
+			write_buf[0] = op->ksrc - out;
+			write_buf[1] = 0;
+			write_buf[2] = 0;
+			kwrite(_pipe_addr + 0x10, (uint64_t *) &write_buf);
+		}
+
+		// Perform read across pipe
+		_read(_rw_pipe[0], op->dest, op->length);
+		out += op->length;
+		next = op->ksrc + op->length;
+	}
+
+	unlock_rw();
 }
@@ -0,0 +1,191 @@
+#include "hijacker.hpp"
+#include "hijacker/mailbox.hpp"
+#include "util.hpp"
+#include "wait.hpp"
+
+extern "C" {
+	#include <stddef.h>
+	#include <stdint.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+	int *__error();
+}
+
+#ifndef SHM_ANON
+#define SHM_ANON ((char *)1)
+#endif
+
+static constexpr uint64_t HANDSHAKE_TIMEOUT = 5000000;
+
+static constinit WaitSite handshakeWait{"Mailbox::create handshake"};
+
+namespace {
+
+extern uint8_t MAILBOX_SHELLCODE[106];
+
+}
+
+namespace nid {
+
+static inline constexpr Nid mmap{"BPE9s9vQQXo"};
+static inline constexpr Nid close{"bY-PO6JhzhQ"};
+static inline constexpr Nid usleep{"QcteRwbsnV0"};
+static inline constexpr Nid errno{"9BcDykPmo1I"};
+
+}
+
+struct MailboxArgs {
+	struct Result {
+		int32_t state;
+		int32_t err;
+	} result;
+	uintptr_t mmap;
+	uintptr_t close;
+	uintptr_t usleep;
+	uintptr_t errno;
+	uintptr_t addr;
+	uint64_t length;
+	int fd;
+
+	MailboxArgs(Hijacker &hijacker, int fd) : result({0, 0}), addr(), length(Mailbox::LENGTH), fd(fd) {
+		mmap = hijacker.getLibKernelFunctionAddress(nid::mmap);
+		close = hijacker.getLibKernelFunctionAddress(nid::close);
+		usleep = hijacker.getLibKernelFunctionAddress(nid::usleep);
+		errno = hijacker.getLibKernelFunctionAddress(nid::errno);
+	}
+};
+
+// the descriptor belongs to the target once it is shared so only the target can close it
+static void closeRemote(Hijacker &hijacker, int remoteFd) {
+	const int res = hijacker.call<int>(hijacker.getLibKernelFunctionAddress(nid::close), remoteFd);
+	if (res != 0) [[unlikely]] {
+		printf("failed to close the mailbox descriptor %d in the target\n", remoteFd);
+	}
+}
+
+UniquePtr<Mailbox> Mailbox::create(Hijacker &hijacker) {
+	const int fd = shm_open(SHM_ANON, O_RDWR, 0600);
+	if (fd == -1) [[unlikely]] {
+		printf("shm_open failed: %s\n", strerror(*__error()));
+		return nullptr;
+	}
+
+	if (ftruncate(fd, LENGTH) == -1) [[unlikely]] {
+		printf("ftruncate failed: %s\n", strerror(*__error()));
+		close(fd);
+		return nullptr;
+	}
+
+	void *local = mmap(nullptr, LENGTH, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (local == MAP_FAILED) [[unlikely]] {
+		printf("mmap failed: %s\n", strerror(*__error()));
+		close(fd);
+		return nullptr;
+	}
+
+	// allocated before sharing so that a failure here still owns fd
+	const uintptr_t argbuf = hijacker.getDataAllocator().allocate(sizeof(MailboxArgs));
+	const uintptr_t entry = hijacker.loadCode(MAILBOX_SHELLCODE);
+	if (argbuf == 0 || entry == 0) [[unlikely]] {
+		puts("no space for the mailbox shellcode");
+		close(fd);
+		munmap(local, LENGTH);
+		return nullptr;
+	}
+
+	// the mapping keeps the shared memory object alive once fd is moved into the target
+	const int remoteFd = hijacker.shareFile(fd);
+	if (remoteFd == -1) [[unlikely]] {
+		puts("failed to share the mailbox with the target");
+		close(fd);
+		munmap(local, LENGTH);
+		return nullptr;
+	}
+
+	MailboxArgs args{hijacker, remoteFd};
+	hijacker.write(argbuf, &args, sizeof(args));
+
+	// the shellcode only closes the descriptor once the mapping succeeded
+	bool mapped = false;
+	{
+		ScopedSuspender suspender{&hijacker};
+		auto frame = hijacker.getTrapFrame();
+		if (frame != nullptr) [[likely]] {
+			// the process may be needed afterwards so the frame must be restored
+			UniquePtr<TrapFrame> backup{new TrapFrame(*frame.get())};
+
+			frame->setRdi(argbuf)
+				.setRip(entry)
+				.setRsp(frame->getRsp() - 0x100) // some extra stack space just incase
+				.flush();
+
+			hijacker.resume();
+
+			// this is the only handshake which must go through the debugger
+			RemoteView<MailboxArgs::Result> res{hijacker.getPid(), argbuf};
+			const bool finished = waitUntil(handshakeWait, [&]() {
+				res.refresh();
+				return res->state != 0;
+			}, Deadline::after(HANDSHAKE_TIMEOUT), BackoffPolicy::fast());
+
+			hijacker.suspend();
+			hijacker.getTrapFrame()->setFrame(backup.get())
+				.flush();
+
+			if (finished && res->state != 1) [[unlikely]] {
+				printf("failed to map the mailbox in the target: %s\n", strerror(res->err));
+			}
+			mapped = finished && res->state == 1;
+		}
+	}
+
+	if (!mapped) [[unlikely]] {
+		// done once the host is resumed since it hijacks the main thread again
+		closeRemote(hijacker, remoteFd);
+		munmap(local, LENGTH);
+		return nullptr;
+	}
+
+	const uintptr_t remote = hijacker.read<uintptr_t>(argbuf + offsetof(MailboxArgs, addr));
+	return new Mailbox((uint8_t *) local, remote);
+}
+
+Mailbox::~Mailbox() {
+	munmap(local, LENGTH);
+}
+
+int32_t Mailbox::wait(const volatile int32_t *state, uint32_t spins, uint32_t sleep, uint32_t maxSleeps) {
+	for (uint32_t i = 0; i < spins; i++) {
+		const int32_t value = *state;
+		if (value != 0) {
+			return value;
+		}
+		__builtin_ia32_pause();
+	}
+	for (uint32_t i = 0; i < maxSleeps; i++) {
+		const int32_t value = *state;
+		if (value != 0) {
+			return value;
+		}
+		usleep(sleep);
+	}
+	return *state;
+}
+
+namespace {
+
+// see shellcode/mailbox.cpp for source
+uint8_t MAILBOX_SHELLCODE[]{
+	0x55, 0x53, 0x48, 0x89, 0xfb, 0x45, 0x31, 0xc9, 0x48, 0x83, 0xec, 0x08, 0xb9, 0x01, 0x00, 0x00,
+	0x00, 0x48, 0x8b, 0x77, 0x30, 0x44, 0x8b, 0x47, 0x38, 0xba, 0x03, 0x00, 0x00, 0x00, 0x31, 0xff,
+	0xff, 0x53, 0x08, 0x48, 0x83, 0xf8, 0xff, 0x74, 0x21, 0x48, 0x89, 0xc5, 0x8b, 0x7b, 0x38, 0xff,
+	0x53, 0x10, 0x48, 0x89, 0x6b, 0x28, 0xc7, 0x03, 0x01, 0x00, 0x00, 0x00, 0x0f, 0x1f, 0x40, 0x00,
+	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0x53, 0x18, 0xeb, 0xf6, 0xff, 0x53, 0x20, 0x8b, 0x00, 0xc7,
+	0x03, 0x02, 0x00, 0x00, 0x00, 0x89, 0x43, 0x04, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xbf, 0x40, 0x42, 0x0f, 0x00, 0xff, 0x53, 0x18, 0xeb, 0xf6
+};
+
+} // anonymous namespace
@@ -1,150 +1,95 @@
+#include "offsets.hpp"
+#include "kernel/discovery.hpp"
 
 extern "C" {
 	#include <stdint.h>
+	#include <stdio.h>
 	#include <sys/types.h>
 	#include <sys/sysctl.h>
+	extern int getpid();
 }
 
-static uint32_t version;
-static size_t allprocOffset;
+static const layout::KernelLayout *currentLayout;
+static layout::KernelLayout discoveredLayout;
+static int detectLock;
 
 static uint32_t getSystemSwVersion() {
-	if (version != 0) [[likely]] {
-		return version;
-	}
-	size_t size = 4;
+	uint32_t version = 0;
+	size_t size = sizeof(version);
 	sysctlbyname("kern.sdk_version", &version, &size, nullptr, 0);
 	return version;
 }
 
-namespace offsets {
+namespace layout {
 
-size_t allproc() {
-	if (allprocOffset != 0) [[likely]] {
-		return allprocOffset;
+// the cache is just a file in /data so it is checked the same way discovery checks a candidate
+static bool isValid(const discovery::LiveReader &reader, const KernelLayout &cached) {
+	if (cached.allproc >= reader.size() || cached.root_vnode >= reader.size()) {
+		return false;
 	}
-	switch(getSystemSwVersion() & 0xffff0000) {
-		case 0x3000000:
-			allprocOffset = 0x276DC58;
-			break;
-		case 0x3100000:
-			allprocOffset = 0x276DC58;
-			break;
-		case 0x3200000:
-			allprocOffset = 0x276DC58;
-			break;
-		case 0x3210000:
-			allprocOffset = 0x276DC58;
-			break;
-		case 0x4020000:
-			allprocOffset = 0x27EDCB8;
-			break;
-		case 0x4030000:
-			allprocOffset = 0x27EDCB8;
-			break;
-		case 0x4500000:
-			allprocOffset = 0x27EDCB8;
-			break;
-		case 0x4510000:
-			allprocOffset = 0x27EDCB8;
-			break;
-		default:
-			allprocOffset = -1;
-			break;
+	if (!discovery::isProcList(reader, reader.base() + cached.allproc, getpid())) {
+		return false;
 	}
-	return allprocOffset;
+	uintptr_t vnode = 0;
+	reader.read(reader.base() + cached.root_vnode, &vnode, sizeof(vnode));
+	return vnode != 0 && vnode == discovery::getRootDirectory(reader, reader.base() + cached.allproc);
 }
 
-size_t security_flags() {
-	switch(getSystemSwVersion() & 0xffff0000) {
-		case 0x3000000:
-			return 0x6466474;
-		case 0x3100000:
-			return 0x6466474;
-		case 0x3200000:
-			return 0x6466474;
-		case 0x3210000:
-			return 0x6466474;
-		case 0x4020000:
-			return 0x6505474;
-		case 0x4030000:
-			return 0x6506474;
-		case 0x4500000:
-			return 0x6506474;
-		case 0x4510000:
-			return 0x6506474;
-		default:
-			return -1;
+static const KernelLayout *discover(uint32_t version) {
+	const discovery::LiveReader reader{};
+	if (discovery::load(version, discoveredLayout)) {
+		if (isValid(reader, discoveredLayout)) [[likely]] {
+			return &discoveredLayout;
+		}
+		puts("the cached kernel offsets are wrong, searching again");
 	}
-}
 
-size_t qa_flags() {
-	switch(getSystemSwVersion() & 0xffff0000) {
-		case 0x3000000:
-			return 0x6466498;
-		case 0x3100000:
-			return 0x6466498;
-		case 0x3200000:
-			return 0x6466498;
-		case 0x3210000:
-			return 0x6466498;
-		case 0x4020000:
-			return 0x6505498;
-		case 0x4030000:
-			return 0x6506498;
-		case 0x4500000:
-			return 0x6506498;
-		case 0x4510000:
-			return 0x6506498;
-		default:
-			return -1;
+	printf("unknown firmware 0x%x, searching for the kernel offsets\n", version);
+	if (!discovery::discover(reader, version, _pipe_addr, getpid(), discoveredLayout)) {
+		puts("failed to find the kernel offsets");
+		return &UNSUPPORTED;
 	}
+
+	printf("allproc: 0x%llx root_vnode: 0x%llx\n",
+		(unsigned long long) discoveredLayout.allproc, (unsigned long long) discoveredLayout.root_vnode);
+	discovery::save(discoveredLayout);
+	return &discoveredLayout;
 }
 
-size_t utoken_flags() {
-	switch(getSystemSwVersion() & 0xffff0000) {
-		case 0x3000000:
-			return 0x6466500;
-		case 0x3100000:
-			return 0x6466500;
-		case 0x3200000:
-			return 0x6466500;
-		case 0x3210000:
-			return 0x6466500;
-		case 0x4020000:
-			return 0x6505500;
-		case 0x4030000:
-			return 0x6506500;
-		case 0x4500000:
-			return 0x6506500;
-		case 0x4510000:
-			return 0x6506500;
-		default:
-			return -1;
+const KernelLayout &detect() {
+	const KernelLayout *layout = __atomic_load_n(&currentLayout, __ATOMIC_ACQUIRE);
+	if (layout != nullptr) [[likely]] {
+		return *layout;
+	}
+	// discovery takes a while so only one thread may do it
+	while (__atomic_exchange_n(&detectLock, 1, __ATOMIC_ACQUIRE)) {
+		__builtin_ia32_pause();
+	}
+	layout = __atomic_load_n(&currentLayout, __ATOMIC_ACQUIRE);
+	if (layout == nullptr) {
+		const uint32_t version = getSystemSwVersion();
+		layout = find(version);
+		if (layout == nullptr) [[unlikely]] {
+			layout = discover(version);
+		}
+		__atomic_store_n(&currentLayout, layout, __ATOMIC_RELEASE);
 	}
+	__atomic_store_n(&detectLock, 0, __ATOMIC_RELEASE);
+	return *layout;
 }
 
-size_t root_vnode() {
-	switch(getSystemSwVersion() & 0xffff0000) {
-		case 0x3000000:
-			return 0x67AB4C0;
-		case 0x3100000:
-			return 0x67AB4C0;
-		case 0x3200000:
-			return 0x67AB4C0;
-		case 0x3210000:
-			return 0x67AB4C0;
-		case 0x4020000:
-			return 0x66E64C0;
-		case 0x4030000:
-			return 0x66E74C0;
-		case 0x4500000:
-			return 0x66E74C0;
-		case 0x4510000:
-			return 0x66E74C0;
-		default:
-			return -1;
+bool matchesRunningFirmware() {
+	if constexpr (BUILD_LAYOUT == nullptr) {
+		// detect handles whatever firmware this is
+		return true;
+	} else {
+		const uint32_t version = getSystemSwVersion() & 0xffff0000;
+		if (version != BUILD_VERSION) [[unlikely]] {
+			printf("built for firmware 0x%x but running on 0x%x\n", BUILD_VERSION >> 16, version >> 16);
+			return false;
+		}
+		return true;
 	}
 }
 
-} // offsets
+} // layout
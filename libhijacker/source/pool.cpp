@@ -0,0 +1,183 @@
+#include "hijacker.hpp"
+#include "hijacker/pool.hpp"
+#include "util.hpp"
+#include "wait.hpp"
+
+extern "C" {
+	#include <signal.h>
+	#include <stdint.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <pthread.h>
+	int *__error();
+}
+
+static constexpr uint64_t STARTUP_TIMEOUT = 5000000;
+static constexpr uint64_t RETRY_DELAY = 10000;
+
+static constinit WaitSite startupWait{"ProcessPool::prepare"};
+static constinit WaitSite idleWait{"ProcessPool::replenish"};
+static constinit WaitSite takeWait{"ProcessPool::take"};
+static constinit WaitSite retryWait{"ProcessPool::retry"};
+
+static void lockPool(int *lock) {
+	while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+		__builtin_ia32_pause();
+	}
+}
+
+static void unlockPool(int *lock) {
+	__atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+ProcessPool::~ProcessPool() {
+	stop();
+	for (size_t i = 0; i < count; i++) {
+		delete ready[i];
+	}
+}
+
+bool ProcessPool::start() {
+	if (!exited) [[unlikely]] {
+		return true;
+	}
+	__atomic_store_n(&running, true, __ATOMIC_RELEASE);
+	exited = false;
+	const int err = pthread_create(&thread, nullptr, replenish, this);
+	if (err != 0) [[unlikely]] {
+		printf("failed to start the process pool: %s\n", strerror(err));
+		running = false;
+		exited = true;
+		return false;
+	}
+	return true;
+}
+
+void ProcessPool::stop() {
+	if (exited) {
+		return;
+	}
+	__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+	pthread_join(thread, nullptr);
+	exited = true;
+}
+
+bool ProcessPool::push(UniquePtr<Hijacker> &&process) {
+	lockPool(&lock);
+	const bool full = count == capacity;
+	if (!full) [[likely]] {
+		ready[count] = process.release();
+		__atomic_store_n(&count, count + 1, __ATOMIC_RELEASE);
+	}
+	unlockPool(&lock);
+	return !full;
+}
+
+UniquePtr<Hijacker> ProcessPool::pop() {
+	lockPool(&lock);
+	Hijacker *process = nullptr;
+	if (count != 0) {
+		// oldest first so that no process is left parked for too long
+		process = ready[0];
+		for (size_t i = 1; i < count; i++) {
+			ready[i - 1] = ready[i];
+		}
+		__atomic_store_n(&count, count - 1, __ATOMIC_RELEASE);
+	}
+	unlockPool(&lock);
+	return process;
+}
+
+void ProcessPool::discard(const Hijacker *process) {
+	if (kill(process->getPid(), SIGKILL) == -1) [[unlikely]] {
+		printf("failed to kill process %d: %s\n", process->getPid(), strerror(*__error()));
+	}
+}
+
+UniquePtr<Hijacker> ProcessPool::prepare() {
+	UniquePtr<Hijacker> process = spawner->spawn();
+	if (process == nullptr) [[unlikely]] {
+		return nullptr;
+	}
+
+	{
+		dbg::Session session{};
+		const bool started = waitUntil(startupWait, [&process]() {
+			return process->getSavedRsp() != 0;
+		}, Deadline::after(STARTUP_TIMEOUT), BackoffPolicy::slow());
+		if (!started) [[unlikely]] {
+			printf("spawned process %d never reached the entry point\n", process->getPid());
+			discard(process.get());
+			return nullptr;
+		}
+	}
+
+	process->getProc()->setName(name);
+	process->jailbreak();
+
+	// do everything a launch would need up front so that only the elf has to be loaded
+	if (process->getAgent() == nullptr) [[unlikely]] {
+		puts("failed to inject the agent into a pooled process");
+		discard(process.get());
+		return nullptr;
+	}
+	if (process->getHeap() == nullptr) [[unlikely]] {
+		puts("failed to create the heap of a pooled process");
+		discard(process.get());
+		return nullptr;
+	}
+
+	printf("pooled process %d is ready\n", process->getPid());
+	return process;
+}
+
+void *ProcessPool::replenish(void *ptr) {
+	ProcessPool *pool = static_cast<ProcessPool *>(ptr);
+	int failures = 0;
+	while (__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)) {
+		// woken by a take or a stop
+		waitUntil(idleWait, [pool]() {
+			return pool->available() != pool->capacity || !__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE);
+		}, Deadline::never(), BackoffPolicy::slow());
+		if (!__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+
+		UniquePtr<Hijacker> process = pool->prepare();
+		if (process == nullptr) [[unlikely]] {
+			if (++failures == MAX_FAILURES) {
+				puts("giving up on replenishing the process pool");
+				break;
+			}
+			// nothing to wake on, just give the system a moment
+			waitUntil(retryWait, []() {
+				return false;
+			}, Deadline::after(RETRY_DELAY), BackoffPolicy::slow());
+			continue;
+		}
+
+		failures = 0;
+		pool->push(static_cast<UniquePtr<Hijacker>&&>(process));
+	}
+	__atomic_store_n(&pool->running, false, __ATOMIC_RELEASE);
+	return nullptr;
+}
+
+UniquePtr<Hijacker> ProcessPool::take() {
+	while (true) {
+		UniquePtr<Hijacker> process = pop();
+		if (process != nullptr) {
+			if (process->isAlive()) [[likely]] {
+				return process;
+			}
+			printf("pooled process %d died while parked\n", process->getPid());
+			continue;
+		}
+		waitUntil(takeWait, [this]() {
+			return available() != 0 || !__atomic_load_n(&running, __ATOMIC_ACQUIRE);
+		}, Deadline::never(), BackoffPolicy::slow());
+		if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE) && available() == 0) [[unlikely]] {
+			return nullptr;
+		}
+	}
+}
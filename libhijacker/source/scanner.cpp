@@ -0,0 +1,339 @@
+#include "dbg.hpp"
+#include "hijacker/scanner.hpp"
+#include "util.hpp"
+#include "wait.hpp"
+#include <immintrin.h>
+
+extern "C" {
+	#include <stdint.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <pthread.h>
+}
+
+// the bytes before a chunk hold the end of the previous one for matches which straddle them
+static constexpr size_t HEADROOM = Pattern::MAX_LENGTH;
+
+// the match buffer starts this big and doubles, a list would recurse once per node on destruction
+static constexpr size_t INITIAL_MATCHES = 16;
+
+static constinit WaitSite fillWait{"scanProcess::fill"};
+static constinit WaitSite takeWait{"scanProcess::take"};
+
+// higher is more common, bytes which aren't listed are assumed to be rare
+static constexpr int commonness(uint8_t b) {
+	constexpr uint8_t COMMON[] = {
+		0x00, 0xff, 0x48, 0x8b, 0x89, 0x0f, 0xe8, 0x24, 0x4c, 0x85,
+		0x74, 0x01, 0x83, 0x45, 0x44, 0x41, 0xc0, 0x08, 0x10, 0x20
+	};
+	for (size_t i = 0; i < sizeof(COMMON); i++) {
+		if (COMMON[i] == b) {
+			return sizeof(COMMON) - i;
+		}
+	}
+	return 0;
+}
+
+static int fromHex(char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+Pattern::Pattern(const char *pattern) : bytes(), mask(), size(), first(), rare() {
+	const char *it = pattern;
+	while (*it != '\0') {
+		if (*it == ' ') {
+			it++;
+			continue;
+		}
+		if (size == MAX_LENGTH) [[unlikely]] {
+			printf("pattern is longer than %llu bytes\n", (unsigned long long) MAX_LENGTH);
+			size = 0;
+			return;
+		}
+		const char hi = it[0];
+		const char lo = (it[1] == '\0' || it[1] == ' ') ? '\0' : it[1];
+		if (lo == '\0' && hi == '?') {
+			// a single ? is a whole byte
+			it++;
+			size++;
+			continue;
+		}
+		const int h = hi == '?' ? 0 : fromHex(hi);
+		const int l = lo == '?' ? 0 : fromHex(lo);
+		if (lo == '\0' || h == -1 || l == -1) [[unlikely]] {
+			printf("invalid byte at %llu in pattern %s\n", (unsigned long long) (it - pattern), pattern);
+			size = 0;
+			return;
+		}
+		mask[size] = (hi == '?' ? 0 : 0xf0) | (lo == '?' ? 0 : 0x0f);
+		bytes[size] = ((h << 4) | l) & mask[size];
+		size++;
+		it += 2;
+	}
+	select();
+}
+
+Pattern::Pattern(const uint8_t *bytes, const uint8_t *mask, size_t length) :
+	bytes(), mask(), size(length <= MAX_LENGTH ? length : 0), first(), rare() {
+	for (size_t i = 0; i < size; i++) {
+		this->mask[i] = mask[i];
+		this->bytes[i] = bytes[i] & mask[i];
+	}
+	select();
+}
+
+void Pattern::select() {
+	size_t known = 0;
+	for (size_t i = 0; i < size; i++) {
+		if (mask[i] != 0xff) {
+			continue;
+		}
+		if (known == 0) {
+			first = i;
+			rare = i;
+		} else if (rare == first || commonness(bytes[i]) < commonness(bytes[rare])) {
+			// a second position filters much better than checking the same byte twice
+			rare = i;
+		}
+		known++;
+	}
+	if (known == 0) [[unlikely]] {
+		puts("pattern has no fully known bytes");
+		size = 0;
+	}
+}
+
+/**
+ * Finds the matches of a pattern in a buffer
+ * Candidates are found 32 positions at a time by comparing the first and rarest known bytes
+ * and then verified against the whole pattern
+ * @param data the buffer
+ * @param length the length of the buffer
+ * @param pattern the pattern
+ * @param match called with the offset of each match until it returns false
+ * @return false if the match stopped the search
+ */
+template <typename Match>
+static bool findPattern(const uint8_t *data, size_t length, const Pattern &pattern, Match &&match) {
+	if (length < pattern.length()) {
+		return true;
+	}
+	const size_t limit = length - pattern.length() + 1;
+	const size_t first = pattern.firstIndex();
+	const size_t rare = pattern.rareIndex();
+	const __m256i firstByte = _mm256_set1_epi8((char) pattern[first]);
+	const __m256i rareByte = _mm256_set1_epi8((char) pattern[rare]);
+
+	size_t i = 0;
+	for (; i + 32 <= limit; i += 32) {
+		const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + first));
+		const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + rare));
+		const __m256i hits = _mm256_and_si256(_mm256_cmpeq_epi8(a, firstByte), _mm256_cmpeq_epi8(b, rareByte));
+		uint32_t bits = _mm256_movemask_epi8(hits);
+		while (bits != 0) {
+			const size_t k = i + __builtin_ctz(bits);
+			bits &= bits - 1;
+			if (pattern.matches(data + k) && !match(k)) {
+				return false;
+			}
+		}
+	}
+	for (; i < limit; i++) {
+		if (data[i + first] == pattern[first] && data[i + rare] == pattern[rare] && pattern.matches(data + i) && !match(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+namespace {
+
+struct ScanSlot {
+	static constexpr int EMPTY = 0;
+	static constexpr int FULL = 1;
+
+	UniquePtr<uint8_t[]> buf;
+	dbg::PageBitmap valid;
+	uintptr_t addr;
+	size_t length;
+	int state;
+
+	ScanSlot() :
+		buf(new uint8_t[HEADROOM + dbg::RANGE_CHUNK_SIZE]), valid(dbg::RANGE_CHUNK_SIZE / dbg::RANGE_PAGE_SIZE),
+		addr(), length(), state(EMPTY) {}
+
+	uint8_t *data() {
+		return buf.get() + HEADROOM;
+	}
+};
+
+// reads the chunks of a region into two slots, one ahead of the scan
+class ChunkReader {
+	static constexpr size_t NUM_SLOTS = 2;
+
+	int pid;
+	uintptr_t base; // the page containing the start of the region
+	uintptr_t start;
+	uintptr_t end;
+	size_t chunks;
+	ScanSlot slots[NUM_SLOTS];
+	bool stopped;
+	bool threaded;
+	pthread_t thread;
+
+	void fill(size_t k) {
+		ScanSlot &slot = slots[k % NUM_SLOTS];
+		const uintptr_t chunkBase = base + k * dbg::RANGE_CHUNK_SIZE;
+		const uintptr_t chunkEnd = chunkBase + dbg::RANGE_CHUNK_SIZE < end ? chunkBase + dbg::RANGE_CHUNK_SIZE : end;
+		slot.addr = chunkBase > start ? chunkBase : start;
+		slot.length = chunkEnd - slot.addr;
+		slot.valid.clear();
+		dbg::Session session{};
+		dbg::readPages(pid, chunkBase, slot.addr, slot.data(), slot.length, slot.valid);
+		__atomic_store_n(&slot.state, ScanSlot::FULL, __ATOMIC_RELEASE);
+	}
+
+	static void *run(void *self) {
+		ChunkReader *reader = static_cast<ChunkReader *>(self);
+		for (size_t k = 0; k < reader->chunks; k++) {
+			ScanSlot &slot = reader->slots[k % NUM_SLOTS];
+			waitUntil(fillWait, [reader, &slot]() {
+				return __atomic_load_n(&slot.state, __ATOMIC_ACQUIRE) == ScanSlot::EMPTY
+					|| __atomic_load_n(&reader->stopped, __ATOMIC_ACQUIRE);
+			});
+			if (__atomic_load_n(&reader->stopped, __ATOMIC_ACQUIRE)) {
+				break;
+			}
+			reader->fill(k);
+		}
+		return nullptr;
+	}
+
+	public:
+		ChunkReader(int pid, const ScanRegion &region) :
+			pid(pid), base(region.start & ~(dbg::RANGE_PAGE_SIZE - 1)), start(region.start), end(region.start + region.length),
+			chunks((end - base + dbg::RANGE_CHUNK_SIZE - 1) / dbg::RANGE_CHUNK_SIZE), slots(), stopped(), threaded(), thread() {
+			// reading is done here instead when there is only one chunk or no thread
+			if (chunks > 1) {
+				const int err = pthread_create(&thread, nullptr, run, this);
+				if (err != 0) [[unlikely]] {
+					printf("failed to start the scan reader, reading synchronously: %s\n", strerror(err));
+				}
+				threaded = err == 0;
+			}
+		}
+		ChunkReader(const ChunkReader&) = delete;
+		ChunkReader &operator=(const ChunkReader&) = delete;
+
+		~ChunkReader() {
+			if (threaded) {
+				__atomic_store_n(&stopped, true, __ATOMIC_RELEASE);
+				pthread_join(thread, nullptr);
+			}
+		}
+
+		size_t length() const {
+			return chunks;
+		}
+
+		uintptr_t chunkBase(size_t k) const {
+			return base + k * dbg::RANGE_CHUNK_SIZE;
+		}
+
+		ScanSlot &take(size_t k) {
+			ScanSlot &slot = slots[k % NUM_SLOTS];
+			if (!threaded) {
+				fill(k);
+				return slot;
+			}
+			waitUntil(takeWait, [&slot]() {
+				return __atomic_load_n(&slot.state, __ATOMIC_ACQUIRE) == ScanSlot::FULL;
+			});
+			return slot;
+		}
+
+		void release(size_t k) {
+			__atomic_store_n(&slots[k % NUM_SLOTS].state, ScanSlot::EMPTY, __ATOMIC_RELEASE);
+		}
+};
+
+} // anonymous
+
+Array<uintptr_t> scanProcess(int pid, const ScanRegion &region, const Pattern &pattern, size_t maxMatches) {
+	if (!pattern || maxMatches == 0 || region.length < pattern.length()) [[unlikely]] {
+		return nullptr;
+	}
+
+	ChunkReader reader{pid, region};
+	// matches are found in ascending order
+	UniquePtr<uintptr_t[]> matches = nullptr;
+	size_t count = 0;
+	size_t capacity = 0;
+	uint8_t tail[HEADROOM];
+	size_t carry = 0;
+	bool done = false;
+	for (size_t k = 0; k < reader.length() && !done; k++) {
+		ScanSlot &slot = reader.take(k);
+		uint8_t *data = slot.data();
+		const uintptr_t chunkBase = reader.chunkBase(k);
+		const size_t prefix = carry;
+		__builtin_memcpy(data - prefix, tail, prefix);
+		carry = 0;
+
+		// scan every run of readable pages, only the first may continue the previous chunk
+		size_t i = 0;
+		while (i < slot.length && !done) {
+			const size_t page = (slot.addr + i - chunkBase) / dbg::RANGE_PAGE_SIZE;
+			const size_t inPage = dbg::RANGE_PAGE_SIZE - ((slot.addr + i) & (dbg::RANGE_PAGE_SIZE - 1));
+			const size_t step = inPage < slot.length - i ? inPage : slot.length - i;
+			if (!slot.valid.test(page)) {
+				i += step;
+				continue;
+			}
+			const size_t runStart = i;
+			i += step;
+			while (i < slot.length && slot.valid.test((slot.addr + i - chunkBase) / dbg::RANGE_PAGE_SIZE)) {
+				i += dbg::RANGE_PAGE_SIZE < slot.length - i ? dbg::RANGE_PAGE_SIZE : slot.length - i;
+			}
+			const size_t extra = runStart == 0 ? prefix : 0;
+			const uintptr_t runAddr = slot.addr + runStart - extra;
+			done = !findPattern(data + runStart - extra, i - runStart + extra, pattern, [&matches, &count, &capacity, runAddr, maxMatches](size_t offset) {
+				if (count == capacity) {
+					capacity = capacity != 0 ? capacity * 2 : INITIAL_MATCHES;
+					if (capacity > maxMatches) {
+						capacity = maxMatches;
+					}
+					uintptr_t *grown = new uintptr_t[capacity];
+					if (count != 0) {
+						__builtin_memcpy(grown, matches.get(), count * sizeof(uintptr_t));
+					}
+					matches = grown;
+				}
+				matches[count++] = runAddr + offset;
+				return count < maxMatches;
+			});
+			if (i == slot.length) {
+				// keep the bytes which could start a match ending in the next chunk
+				const size_t runLength = i - runStart + extra;
+				carry = pattern.length() - 1 < runLength ? pattern.length() - 1 : runLength;
+				__builtin_memcpy(tail, data + i - carry, carry);
+			}
+		}
+		reader.release(k);
+	}
+
+	Array<uintptr_t> result{count};
+	if (count != 0) {
+		__builtin_memcpy(result.data(), matches.get(), count * sizeof(uintptr_t));
+	}
+	return result;
+}
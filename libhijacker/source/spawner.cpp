@@ -1,12 +1,23 @@
 #include "dbg/dbg.hpp"
 #include "hijacker.hpp"
+#include "wait.hpp"
 #include <sys/_stdint.h>
 
 extern "C" {
+	#include <signal.h>
 	#include <stdio.h>
-	int usleep(unsigned int);
+	#include <string.h>
+	int *__error();
 }
 
+static constexpr uint64_t SPAWN_TIMEOUT = 10000000;
+static constexpr uint64_t STARTUP_TIMEOUT = 5000000;
+
+static constinit WaitSite spawnWait{"Spawner::spawn spawn"};
+static constinit WaitSite nameWait{"Spawner::spawn eboot name"};
+static constinit WaitSite hijackerWait{"Spawner::spawn hijacker"};
+static constinit WaitSite libkernelWait{"Spawner::spawn libkernel"};
+
 // this always seems to be the case
 static constexpr uintptr_t ENTRYPOINT_OFFSET = 0x70;
 
@@ -78,12 +89,15 @@ struct Args {
 };
 
 Spawner::Spawner(Hijacker *ptr) :
-		pids(dbg::getAllPids()), state(), hijacker(ptr),
+		pids(dbg::getAllPids()), hijacker(ptr),
 		entry(), dlsym(), nanosleepOffset(), argbuf(), pid(ptr->getPid()) {
-	argbuf = hijacker->dataAllocator.allocate(sizeof(Args));
-	state = {pid, argbuf};
-	entry = hijacker->textAllocator.allocate(sizeof(SHELLCODE));
-	hijacker->write(entry, SHELLCODE);
+	// this lives for as long as the spawner so it is never released
+	argbuf = hijacker->allocateScratch(sizeof(Args));
+	entry = hijacker->loadCode(SHELLCODE);
+	if (argbuf == 0 || entry == 0) [[unlikely]] {
+		// spawn checks these and fails before touching the process
+		puts("failed to allocate the spawner shellcode");
+	}
 	dlsym = hijacker->getLibKernelFunctionAddress(nid::sceKernelDlsym);
 	uintptr_t addr = hijacker->getLibKernelFunctionAddress(nid::_nanosleep);
 	nanosleepOffset = addr - hijacker->getLibKernelBase();
@@ -93,28 +107,46 @@ int32_t Spawner::getResult() const {
 
 	// we are state when a new process has spawned or the hijacked process has died
 
+	// give the shellcode some time before falling back to the expensive checks
+	const int32_t res = hijacker->pollState(argbuf, 0x100);
+	if (res != 0) {
+		return res;
+	}
+
 	auto frame = hijacker->getTrapFrame();
 	if (frame == nullptr) {
 		return -2;
 	}
 
-	uint64_t res = *state;
-	if (res != 0) {
-		return res;
-	}
-
 	auto ids = dbg::getAllPids();
 
 	return ids.contains(pid) && ids.length() > pids.length();
 }
 
+// the process is parked before its entrypoint and would otherwise be left behind
+static void killUnfinished(int id) {
+	if (kill(id, SIGKILL) == -1) [[unlikely]] {
+		printf("failed to kill unfinished process %d: %s\n", id, strerror(*__error()));
+		return;
+	}
+	printf("killed process %d which did not finish starting\n", id);
+}
+
 UniquePtr<Hijacker> Spawner::spawn() {
+	if (argbuf == 0 || entry == 0) [[unlikely]] {
+		puts("no space for the spawner shellcode");
+		return nullptr;
+	}
+	// every poll below is an mdbg call
+	dbg::Session session{};
+	// refreshed so that the spawner may be used more than once
+	pids = dbg::getAllPids();
 	int currentId = pids[0];
 	int id = -1;
 	LoopBuilder loop = SLEEP_LOOP;
 	{
 		Args args{*hijacker.get()};
-		dbg::write(pid, argbuf, &args, sizeof(args));
+		hijacker->write(argbuf, &args, sizeof(args));
 		ScopedSuspender suspender{hijacker.get()};
 		auto frame = hijacker->getTrapFrame();
 		if (frame == nullptr) {
@@ -123,6 +155,16 @@ UniquePtr<Hijacker> Spawner::spawn() {
 
 		UniquePtr<TrapFrame> backup{new TrapFrame(*frame.get())};
 
+		// the host must get its own frame back on every way out of here
+		// or it stays in the shellcode and the next spawn saves the wrong frame
+		auto restore = [this, &backup]() {
+			hijacker->suspend();
+			auto current = hijacker->getTrapFrame();
+			if (current != nullptr) [[likely]] {
+				current->setFrame(backup.get()).flush();
+			}
+		};
+
 		frame->setRdi(argbuf)
 			.setRip(entry)
 			.setRsp(frame->getRsp() - 0x100) // some extra stack space just incase
@@ -131,17 +173,25 @@ UniquePtr<Hijacker> Spawner::spawn() {
 		// wait for the new process to spawn
 		hijacker->resume();
 		int32_t state = 0;
-		do {
+		// getResult blocks for a while before doing the expensive checks
+		const bool spawned = waitUntil(spawnWait, [&]() {
 			state = getResult();
-		} while (state == 0);
+			return state != 0;
+		}, Deadline::after(SPAWN_TIMEOUT), BackoffPolicy::blocking());
+
+		if (!spawned) [[unlikely]] {
+			puts("timed out waiting for the process to spawn");
+			restore();
+			return nullptr;
+		}
 
 		if (state != 1) [[unlikely]] {
 			if (state == -2) {
 				// process died
 				return nullptr;
 			}
-			ProcessPointer<Args::Result> pres{pid, argbuf};
-			Args::Result res = *pres;
+			Args::Result res = hijacker->read<Args::Result>(argbuf);
+			restore();
 			if (res.state == -1) {
 				printf("spawn failed err: %s\n", strerror(res.err));
 			} else if (res.state > 1) {
@@ -152,9 +202,7 @@ UniquePtr<Hijacker> Spawner::spawn() {
 			return nullptr;
 		}
 
-		hijacker->suspend();
-		hijacker->getTrapFrame()->setFrame(backup.get())
-			.flush();
+		restore();
 	}
 
 	// this should never miss because the pid lock is currently
@@ -175,22 +223,48 @@ UniquePtr<Hijacker> Spawner::spawn() {
 	// otherwise we go too fast and get stuck
 	StringView name = "eboot.bin";
 	puts("waiting for name to be set");
-	while (info->name() != name && info->name()) {
-		usleep(1); // some delay is needed or it will never proceed
+	// some delay is needed or it will never proceed
+	const bool named = waitUntil(nameWait, [&]() {
+		if (info->name() == name || !info->name()) {
+			return true;
+		}
 		info = new dbg::ProcessInfo(id);
+		return false;
+	}, Deadline::after(STARTUP_TIMEOUT), BackoffPolicy::slow());
+
+	if (!named) [[unlikely]] {
+		killUnfinished(id);
+		return nullptr;
 	}
 
 	UniquePtr<Hijacker> spawned = nullptr;
-	while (spawned == nullptr) {
+	const bool attached = waitUntil(hijackerWait, [&]() {
 		spawned = Hijacker::getHijacker(id);
+		return spawned != nullptr;
+	}, Deadline::after(STARTUP_TIMEOUT), BackoffPolicy::fast());
+
+	if (!attached) [[unlikely]] {
+		killUnfinished(id);
+		return nullptr;
 	}
 
 	uintptr_t base = 0;
-	while (base == 0) {
+	const bool loaded = waitUntil(libkernelWait, [&]() {
 		base = spawned->getLibKernelBase();
+		return base != 0;
+	}, Deadline::after(STARTUP_TIMEOUT), BackoffPolicy::fast());
+
+	if (!loaded) [[unlikely]] {
+		killUnfinished(id);
+		return nullptr;
 	}
 
 	const uintptr_t rsp = spawned->getDataAllocator().allocate(8);
+	if (rsp == 0) [[unlikely]] {
+		puts("no space for the saved stack pointer");
+		killUnfinished(id);
+		return nullptr;
+	}
 	loop.setStackPointer(rsp);
 	loop.setTarget(base + nanosleepOffset);
 	base = spawned->imagebase();
@@ -0,0 +1,89 @@
+#include "kernel/vmmap.hpp"
+#include "kernel/proc.hpp"
+#include "util.hpp"
+
+extern "C" {
+	#include <stdint.h>
+	#include <stdio.h>
+}
+
+static constexpr uintptr_t alignUp(uintptr_t addr, size_t align) {
+	return (addr + (align - 1)) & ~(align - 1);
+}
+
+UniquePtr<VmMap> VmMap::read(const KProc &proc) {
+	// the vm_map is the first member of the vmspace and begins with the header entry
+	const uintptr_t header = proc.p_vmspace();
+	if (header == 0) [[unlikely]] {
+		return nullptr;
+	}
+
+	// the header's start and end are the bounds of the map
+	KVmMapEntry head{header};
+	Array<VmMapEntry> entries{0x100};
+	size_t count = 0;
+	uintptr_t last = head.start();
+	for (uintptr_t addr = head.next(); addr != header; ) {
+		if (addr == 0 || count == MAX_ENTRIES) [[unlikely]] {
+			puts("VmMap::read failed to walk the map entries");
+			return nullptr;
+		}
+		KVmMapEntry entry{addr};
+		if (entry.start() < last || entry.end() <= entry.start()) [[unlikely]] {
+			// either the map changed under us or the layout is wrong for this firmware
+			printf("VmMap::read unexpected entry 0x%llx-0x%llx\n", (unsigned long long) entry.start(), (unsigned long long) entry.end());
+			return nullptr;
+		}
+		if (count == entries.length()) {
+			Array<VmMapEntry> grown{count * 2};
+			__builtin_memcpy(grown.data(), entries.data(), sizeof(VmMapEntry) * count);
+			entries = static_cast<Array<VmMapEntry>&&>(grown);
+		}
+		entries[count++] = {entry.start(), entry.end(), entry.object(), entry.protection(), entry.maxProtection()};
+		last = entry.end();
+		addr = entry.next();
+	}
+
+	return new VmMap{static_cast<Array<VmMapEntry>&&>(entries), count, head.start(), head.end()};
+}
+
+const VmMapEntry *VmMap::find(uintptr_t addr) const {
+	size_t lo = 0;
+	size_t hi = count;
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		const VmMapEntry &entry = entries[mid];
+		if (addr < entry.start) {
+			hi = mid;
+		} else if (addr >= entry.end) {
+			lo = mid + 1;
+		} else {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+uintptr_t VmMap::findFree(size_t size, size_t align, uintptr_t hint) const {
+	if (size == 0) [[unlikely]] {
+		return 0;
+	}
+	uintptr_t candidate = alignUp(hint > minAddress ? hint : minAddress, align);
+	for (const VmMapEntry &entry : *this) {
+		if (entry.end <= candidate) {
+			continue;
+		}
+		if (candidate + size <= entry.start && candidate + size > candidate) {
+			return candidate;
+		}
+		candidate = alignUp(entry.end, align);
+		if (candidate == 0) [[unlikely]] {
+			// wrapped around
+			return 0;
+		}
+	}
+	if (candidate + size <= maxAddress && candidate + size > candidate) {
+		return candidate;
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+#include "wait.hpp"
+
+extern "C" {
+	#include <stdint.h>
+	#include <stdio.h>
+	#include <time.h>
+	int usleep(unsigned int useconds);
+	int sched_yield();
+}
+
+static WaitSite *sites;
+
+uint64_t getMicroseconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void waitSleep(uint32_t micros) {
+	usleep(micros);
+}
+
+void waitYield() {
+	sched_yield();
+}
+
+void WaitSite::add() {
+	// only the first thread to record publishes the site
+	if (__atomic_exchange_n(&registered, true, __ATOMIC_ACQ_REL)) {
+		return;
+	}
+	WaitSite *head = __atomic_load_n(&sites, __ATOMIC_ACQUIRE);
+	do {
+		next = head;
+	} while (!__atomic_compare_exchange_n(&sites, &head, this, true, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+}
+
+void WaitSite::record(uint64_t micros, bool timedOut) {
+	if (!__atomic_load_n(&registered, __ATOMIC_ACQUIRE)) [[unlikely]] {
+		add();
+	}
+	const size_t bucket = micros == 0 ? 0 : 63 - __builtin_clzll(micros);
+	__atomic_fetch_add(&buckets[bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&total, micros, __ATOMIC_RELAXED);
+	if (timedOut) [[unlikely]] {
+		__atomic_fetch_add(&timeouts, 1, __ATOMIC_RELAXED);
+	}
+	uint64_t current = __atomic_load_n(&longest, __ATOMIC_RELAXED);
+	while (micros > current && !__atomic_compare_exchange_n(&longest, &current, micros, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+void WaitSite::dumpAll() {
+	for (const WaitSite *site = __atomic_load_n(&sites, __ATOMIC_ACQUIRE); site != nullptr; site = site->next) {
+		const uint64_t n = __atomic_load_n(&site->count, __ATOMIC_RELAXED);
+		printf("%s: %llu waits, %llu timeouts, mean %llu us, max %llu us\n", site->name,
+			(unsigned long long) n, (unsigned long long) site->timeouts,
+			(unsigned long long) (n != 0 ? site->total / n : 0), (unsigned long long) site->longest);
+		for (size_t i = 0; i < NUM_BUCKETS; i++) {
+			const uint64_t hits = __atomic_load_n(&site->buckets[i], __ATOMIC_RELAXED);
+			if (hits != 0) {
+				printf("  < %llu us: %llu\n", 1ULL << (i + 1), (unsigned long long) hits);
+			}
+		}
+	}
+}
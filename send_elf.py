@@ -61,17 +61,46 @@ async def open_connection(host: str, port: int):
             writer.close()
 
 
-async def send_elf(host: str, elf: Path):
-    async with open_connection(host, ELF_PORT) as (_, writer):
+LAUNCH_MAGIC = 0x31464c4548434e4c
+LAUNCH_RESOLVE_ON_HOST = 1
+LAUNCH_VERIFY_IMPORTS = 2
+LAUNCH_RESULTS = ('launched', 'launch queue is full', 'bad request', 'no process available', 'launch failed')
+
+
+async def send_elf(host: str, elf: Path, pid: int = 0, flags: int = 0):
+    async with open_connection(host, ELF_PORT) as (reader, writer):
         data = elf.read_bytes()
+        if pid or flags:
+            writer.write(LAUNCH_MAGIC.to_bytes(8, byteorder='little'))
+            writer.write(pid.to_bytes(4, byteorder='little'))
+            writer.write(flags.to_bytes(4, byteorder='little'))
         writer.write(len(data).to_bytes(8, byteorder='little'))
         writer.write(data)
         writer.write_eof()
         await writer.drain()
+        try:
+            status = await reader.readexactly(8)
+        except asyncio.IncompleteReadError:
+            print(f'{elf}: no status received')
+            return
+        result = int.from_bytes(status[:4], byteorder='little', signed=True)
+        target = int.from_bytes(status[4:], byteorder='little', signed=True)
+        message = LAUNCH_RESULTS[result] if 0 <= result < len(LAUNCH_RESULTS) else f'unknown result {result}'
+        print(f'{elf}: {message} (pid {target})')
+
+
+async def send_elfs(host: str, elfs: list[Path], pid: int = 0, flags: int = 0):
+    if pid:
+        # launches into the same process happen in the order they were received
+        # so wait for each status before sending the next elf
+        for elf in elfs:
+            await send_elf(host, elf, pid, flags)
+        return
+    # every elf gets its own process so the order they launch in doesn't matter
+    await asyncio.gather(*(send_elf(host, elf, pid, flags) for elf in elfs))
 
 
-async def log_task(host: str, reader: asyncio.StreamReader, elf: Path, log: Path | None, silent = False):
-    sent_elf = False
+async def log_task(reader: asyncio.StreamReader, log: Path | None, silent = False):
     async with get_logger(log) as fp:
         line = b''
         while True:
@@ -86,13 +115,6 @@ async def log_task(host: str, reader: asyncio.StreamReader, elf: Path, log: Path
                 continue
 
             line = line.decode('latin-1')
-            if not sent_elf and line.startswith('waiting for connection'):
-                if not silent:
-                    if '\r' not in line:
-                        await fp.write(line)
-                    print(line, end='')
-                await send_elf(host, elf)
-                sent_elf = True
             if silent:
                 continue
             if '\r' not in line:
@@ -100,7 +122,7 @@ async def log_task(host: str, reader: asyncio.StreamReader, elf: Path, log: Path
             print(line, end='')
 
 
-async def logger_client(host: str, elf: Path, spawner: Path, log: Path | None, silent: bool):
+async def logger_client(host: str, spawner: Path, log: Path | None, silent: bool):
     # waiting for connection
     async with SEM:
         async with open_connection(host, LOGGER_PORT) as (reader, writer):
@@ -108,7 +130,7 @@ async def logger_client(host: str, elf: Path, spawner: Path, log: Path | None, s
             writer.write(spawner.read_bytes())
             writer.write_eof()
             await writer.drain()
-            await log_task(host, reader, elf, log, silent)
+            await log_task(reader, log, silent)
 
 
 async def send_spawner(host: str, spawner: Path):
@@ -121,16 +143,20 @@ async def send_spawner(host: str, spawner: Path):
             await writer.drain()
 
 
-async def run_loggers(host: str, elf: Path, spawner: Path, log: Path | None, silent: bool):
+async def run_loggers(host: str, elfs: list[Path], spawner: Path, log: Path | None, silent: bool, pid: int, flags: int):
     await send_spawner(host, spawner)
 
     # klogger code was left incase it's helpful for someone in the future
-    logger = asyncio.create_task(logger_client(host, elf, spawner, log, silent))
+    logger = asyncio.create_task(logger_client(host, spawner, log, silent))
+    # the spawner listens for elfs as soon as it starts so don't wait for it to log anything
+    sender = asyncio.create_task(send_elfs(host, elfs, pid, flags))
     #klogger = asyncio.create_task(klog_client(host))
     tasks = (logger, ) #klogger)
     await asyncio.wait(tasks, return_when=asyncio.FIRST_COMPLETED)
     if not logger.done():
         await asyncio.wait_for(logger, timeout=None)
+    if not sender.done():
+        sender.cancel()
     #if not klogger.done():
     #    klogger.cancel()
 
@@ -141,7 +167,7 @@ def main():
         epilog='Text at the bottom of help'
     )
     parser.add_argument('ip', help='PS5 ip address')
-    parser.add_argument('elf', help='Path to the elf to load into the spawned process')
+    parser.add_argument('elf', nargs='+', help='Path to the elfs to load into spawned processes')
     parser.add_argument(
         '--spawner',
         default='bin/spawner.elf',
@@ -158,6 +184,30 @@ def main():
         action='store_true',
         help='Switch to disable logging to an output file. (default False)'
     )
+    parser.add_argument(
+        '--pid',
+        default=0,
+        type=int,
+        help='Load the elfs into this existing process instead of new ones. (default: 0)'
+    )
+    parser.add_argument(
+        '--resolve-on-host',
+        default=False,
+        action='store_true',
+        help='Resolve imports by copying the symbol tables instead of in the target process. (default: False)'
+    )
+    parser.add_argument(
+        '--verify-imports',
+        default=False,
+        action='store_true',
+        help='Check the imports resolved in the target process against the symbol tables. (default: False)'
+    )
+    parser.add_argument(
+        '--running',
+        default=False,
+        action='store_true',
+        help='Only send the elfs to a spawner which is already running. (default: False)'
+    )
     parser.add_argument(
         '--silent',
         default=False,
@@ -166,18 +216,27 @@ def main():
     )
     args = parser.parse_args()
     try:
-        elf = Path(args.elf)
+        elfs = [Path(elf) for elf in args.elf]
         spawner = Path(args.spawner)
         log = Path(args.log)
         if args.nolog:
             log = None
+        flags = 0
+        if args.resolve_on_host:
+            flags |= LAUNCH_RESOLVE_ON_HOST
+        if args.verify_imports:
+            flags |= LAUNCH_VERIFY_IMPORTS
+        for elf in elfs:
+            if not elf.exists():
+                print(f'{elf} does not exist')
+                return
+        if args.running:
+            asyncio.run(send_elfs(args.ip, elfs, args.pid, flags))
+            return
         if not spawner.exists():
             print(f'{spawner} does not exist')
             return
-        if not elf.exists():
-            print(f'{elf} does not exist')
-            return
-        asyncio.run(run_loggers(args.ip, elf, spawner, log, args.silent))
+        asyncio.run(run_loggers(args.ip, elfs, spawner, log, args.silent, args.pid, flags))
     except KeyboardInterrupt:
         pass
 
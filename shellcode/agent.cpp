@@ -0,0 +1,92 @@
+
+typedef unsigned long long u64;
+typedef long long s64;
+typedef unsigned int u32;
+typedef int s32;
+
+constexpr u32 MAX_ARGS = 12;
+constexpr u32 NUM_SLOTS = 32;
+constexpr u32 SPINS = 0x10000;
+constexpr int IDLE_SLEEP = 50;
+
+enum Op : u32 {
+	CALL,
+	COPY,
+	START
+};
+
+struct Command {
+	u32 op;
+	s32 err;
+	s64 result;
+	u64 fn;
+	u64 args[MAX_ARGS];
+};
+
+struct Queue {
+	u32 head;
+	u32 tail;
+	u32 started;
+	u32 reserved;
+	int (*usleep)(int);
+	int *(*error)();
+	Command commands[NUM_SLOTS];
+};
+
+// any unused arguments are ignored by the callee
+typedef s64 (*Function)(u64, u64, u64, u64, u64, u64, u64, u64, u64, u64, u64, u64);
+
+[[noreturn]] void agent(Queue *__restrict queue) {
+	u32 tail = queue->tail;
+	u32 idle = 0;
+	// lets the loader know the main thread actually reached us
+	__atomic_store_n(&queue->started, 1, __ATOMIC_RELEASE);
+
+	while (true) {
+		if (__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == tail) {
+			// stay responsive while the loader is busy but don't hog the cpu
+			if (idle < SPINS) {
+				idle++;
+				__builtin_ia32_pause();
+			} else {
+				queue->usleep(IDLE_SLEEP);
+			}
+			continue;
+		}
+		idle = 0;
+
+		Command *__restrict cmd = queue->commands + (tail % NUM_SLOTS);
+		const u64 *a = cmd->args;
+		switch (cmd->op) {
+			case CALL:
+				*queue->error() = 0;
+				cmd->result = ((Function) cmd->fn)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9], a[10], a[11]);
+				cmd->err = *queue->error();
+				break;
+			case COPY: {
+				void *dst = (void *) a[0];
+				const void *src = (const void *) a[1];
+				u64 length = a[2];
+				__asm__ volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(length) : : "memory");
+				cmd->result = 0;
+				cmd->err = 0;
+				break;
+			}
+			case START:
+				// the loader no longer needs this thread
+				__asm__ volatile(
+					"mov %0, %%rsp\n"
+					"xor %%ebp, %%ebp\n"
+					"jmp *%2\n"
+					: : "r"(a[0]), "D"(a[1]), "r"(cmd->fn) : "memory"
+				);
+				__builtin_unreachable();
+			default:
+				cmd->result = -1;
+				cmd->err = 22; // EINVAL
+				break;
+		}
+
+		__atomic_store_n(&queue->tail, ++tail, __ATOMIC_RELEASE);
+	}
+}
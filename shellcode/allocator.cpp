@@ -12,6 +12,13 @@ constexpr u32 MAP_SHARED   = 0x1;
 constexpr u32 MAP_PRIVATE   = 0x2;
 constexpr u32 MAP_FIXED     = 0x10;
 constexpr u32 MAP_ANONYMOUS = 0x1000;
+constexpr u32 MAP_EXCL      = 0x4000;
+
+constexpr int ENOMEM = 12;
+constexpr int EEXIST = 17;
+
+// something was mapped into the range picked by the loader after it read the vm map
+constexpr s32 STATE_COLLIDED = 6;
 
 constexpr s64 MAP_FAILED = -1;
 
@@ -20,6 +27,7 @@ struct Info {
 	u64 length;
 	s64 result;
 	u32 protection;
+	u64 offset;
 };
 
 struct Args {
@@ -27,73 +35,113 @@ struct Args {
 		s32 state;
 		s32 err;
 	} result;
-	int (*usleep)(int);
 	s64 (*mmap)(u64 addr, u64 len, u32 prot, u32 flags, int fd, u64 offset);
 	int (*munmap)(u64 addr, u64 len);
+	int (*close)(int fd);
 	int (*sceKernelJitCreateSharedMemory)(void *addr, u64 length, u32 flags, int *p_fd);
+	int (*sceKernelJitCreateAliasOfSharedMemory)(int fd, u32 maxProt, int *p_fd);
 	int *(*errno)();
 	Info *__restrict info;
+	u64 address;
 	int numInfo;
+	int dataFd;
+	int aliasFd;
 };
 
 
-[[noreturn]] void shellcode(Args *__restrict args) {
+static void fail(Args *__restrict args, s32 state, s32 err, int jitFd, int mapped) {
+	for (int i = 0; i < mapped; i++) {
+		args->munmap(args->info[i].result, args->info[i].length);
+	}
+	// the descriptors would otherwise stay open in the target forever
+	if (jitFd != -1) {
+		args->close(jitFd);
+	}
+	if (args->aliasFd != -1) {
+		args->close(args->aliasFd);
+		args->aliasFd = -1;
+	}
+	// the loader retries a collision with the same data file
+	if (state != STATE_COLLIDED && args->dataFd != -1) {
+		args->close(args->dataFd);
+	}
+	args->result = {state, err};
+}
+
+static s32 mmapFailure(Args *__restrict args, s32 state, int err) {
+	return args->address != 0 && (err == EEXIST || err == ENOMEM) ? STATE_COLLIDED : state;
+}
+
+void shellcode(Args *__restrict args) {
 
-	u64 totalSize = 0;
+	// the loader picks a free range from the vm map when it can
+	// MAP_EXCL makes the mmap fail instead of replacing anything mapped since then
+	s64 mem = args->address;
+	const u32 fixed = mem != 0 ? MAP_FIXED | MAP_EXCL : MAP_FIXED;
 
-	for (int i = 0; i < args->numInfo; i++) {
-		totalSize += args->info[i].length;
-	}
+	if (mem == 0) [[unlikely]] {
+		u64 totalSize = 0;
 
-	// should help ensure we get a contiguous range
-	s64 mem = args->mmap(0, totalSize, PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-	if (mem == -1) [[unlikely]] {
-		args->result = {2, *args->errno()};
-		while (true) {
-			args->usleep(1000000);
+		for (int i = 0; i < args->numInfo; i++) {
+			totalSize += args->info[i].length;
 		}
-	}
 
-	args->munmap(mem, totalSize);
+		// should help ensure we get a contiguous range
+		mem = args->mmap(0, totalSize, PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (mem == -1) [[unlikely]] {
+			fail(args, 2, *args->errno(), -1, 0);
+			return;
+		}
+
+		args->munmap(mem, totalSize);
+	}
 
 	const auto length = args->info[0].length;
 
 	int fd = -1;
 	int res = args->sceKernelJitCreateSharedMemory(nullptr, length, PROT_READ|PROT_WRITE|PROT_EXEC, &fd);
 	if (res != 0) [[unlikely]] {
-		args->result = {3, res};
-		while (true) {
-			args->usleep(1000000);
-		}
+		fail(args, 3, res, -1, 0);
+		return;
 	}
 
 	// it's very picky with what it allows for jit
-	const auto imagebase = args->mmap(mem, length, PROT_EXEC, MAP_FIXED | MAP_SHARED, fd, 0);
+	const auto imagebase = args->mmap(mem, length, PROT_EXEC, fixed | MAP_SHARED, fd, 0);
 	args->info[0].result = imagebase;
 	if (imagebase == MAP_FAILED) [[unlikely]] {
-		args->result = {4, *args->errno()};
-		while (true) {
-			args->usleep(1000000);
-		}
+		const int err = *args->errno();
+		fail(args, mmapFailure(args, 4, err), err, fd, 0);
+		return;
 	}
 
+	// the loader maps the alias to write the text without the debugger
+	int alias = -1;
+	if (args->sceKernelJitCreateAliasOfSharedMemory(fd, PROT_READ | PROT_WRITE, &alias) != 0) [[unlikely]] {
+		alias = -1;
+	}
+	args->aliasFd = alias;
+
+	const int dataFd = args->dataFd;
 	for (int i = 1; i < args->numInfo; i++) {
 		// ensure they are contiguous in loader
 		const u64 length = args->info[i].length;
 		const u64 addr = args->info[i].paddr + imagebase;
-		auto mmapResult = args->mmap(addr, length, args->info[i].protection, MAP_FIXED | MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		const u32 prot = args->info[i].protection;
+		// the data file is shared with the loader when it was provided
+		auto mmapResult = dataFd != -1 ?
+			args->mmap(addr, length, prot, fixed | MAP_SHARED, dataFd, args->info[i].offset) :
+			args->mmap(addr, length, prot, fixed | MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
 		args->info[i].result = mmapResult;
 		if (mmapResult == MAP_FAILED) [[unlikely]] {
-			args->result = {5, *args->errno()};
-			while (true) {
-				args->usleep(1000000);
-			}
+			const int err = *args->errno();
+			fail(args, mmapFailure(args, 5, err), err, fd, i);
+			return;
 		}
 	}
 
-	args->result.state = 1;
-
-	while (true) {
-		args->usleep(1000000);
+	if (dataFd != -1) {
+		args->close(dataFd);
 	}
+
+	args->result.state = 1;
 }
@@ -0,0 +1,49 @@
+
+typedef unsigned long long u64;
+typedef long long s64;
+typedef unsigned int u32;
+typedef int s32;
+
+constexpr u32 PROT_READ = 1;
+constexpr u32 PROT_WRITE = 2;
+
+constexpr u32 MAP_SHARED = 0x1;
+
+constexpr s64 MAP_FAILED = -1;
+
+struct Args {
+	struct Result {
+		s32 state;
+		s32 err;
+	} result;
+	s64 (*mmap)(u64 addr, u64 len, u32 prot, u32 flags, int fd, u64 offset);
+	int (*close)(int fd);
+	int (*usleep)(int);
+	int *(*errno)();
+	s64 addr;
+	u64 length;
+	int fd;
+};
+
+[[noreturn]] void shellcode(Args *__restrict args) {
+
+	// the fd was placed into our table by the loader
+	const s64 mem = args->mmap(0, args->length, PROT_READ | PROT_WRITE, MAP_SHARED, args->fd, 0);
+	if (mem == MAP_FAILED) [[unlikely]] {
+		args->result = {2, *args->errno()};
+		while (true) {
+			args->usleep(1000000);
+		}
+	}
+
+	// the mapping keeps the object alive
+	args->close(args->fd);
+	args->addr = mem;
+
+	// the loader reads addr as soon as it sees the state change
+	__atomic_store_n(&args->result.state, 1, __ATOMIC_RELEASE);
+
+	while (true) {
+		args->usleep(1000000);
+	}
+}
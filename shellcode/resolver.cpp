@@ -0,0 +1,40 @@
+
+typedef unsigned long long u64;
+typedef unsigned int u32;
+typedef int s32;
+
+struct Args {
+	struct Result {
+		s32 state;
+		s32 err;
+	} result;
+	int (*sceKernelDlsym)(int handle, const char *symbol, void **addrp);
+	const char *__restrict strtab;
+	const int *__restrict handles;
+	const u32 *__restrict names;
+	u64 *__restrict addresses;
+	int numHandles;
+	int numNames;
+};
+
+void shellcode(Args *__restrict args) {
+
+	for (int i = 0; i < args->numNames; i++) {
+		const char *name = args->strtab + args->names[i];
+		void *addr = nullptr;
+		// search the libraries in the same order as the loader
+		for (int j = 0; j < args->numHandles; j++) {
+			if (args->sceKernelDlsym(args->handles[j], name, &addr) == 0 && addr != nullptr) {
+				break;
+			}
+			addr = nullptr;
+		}
+		if (addr == nullptr) [[unlikely]] {
+			args->result = {2, i};
+			return;
+		}
+		args->addresses[i] = (u64) addr;
+	}
+
+	args->result.state = 1;
+}
@@ -0,0 +1,46 @@
+
+typedef unsigned long long u64;
+typedef long long s64;
+typedef unsigned int u32;
+typedef int s32;
+
+constexpr u32 MAX_ARGS = 12;
+
+struct Call {
+	u64 fn;
+	u64 args[MAX_ARGS];
+	s64 result;
+	s32 err;
+};
+
+struct Args {
+	struct Result {
+		s32 state;
+		s32 err;
+	} result;
+	int (*usleep)(int);
+	int *(*errno)();
+	u64 numCalls;
+	Call calls[];
+};
+
+// any unused arguments are ignored by the callee
+typedef s64 (*Function)(u64, u64, u64, u64, u64, u64, u64, u64, u64, u64, u64, u64);
+
+[[noreturn]] void shellcode(Args *__restrict args) {
+
+	for (u64 i = 0; i < args->numCalls; i++) {
+		Call *__restrict call = args->calls + i;
+		const u64 *a = call->args;
+		*args->errno() = 0;
+		call->result = ((Function) call->fn)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9], a[10], a[11]);
+		call->err = *args->errno();
+	}
+
+	// the loader reads the results as soon as it sees the state change
+	__atomic_store_n(&args->result.state, 1, __ATOMIC_RELEASE);
+
+	while (true) {
+		args->usleep(1000000);
+	}
+}
@@ -4,8 +4,10 @@
 #include "elf/elf.hpp"
 #include "kernel.hpp"
 #include "hijacker.hpp"
+#include "hijacker/pool.hpp"
 #include "kernel/kernel.hpp"
 #include "util.hpp"
+#include "wait.hpp"
 #include <unistd.h>
 
 
@@ -23,11 +25,16 @@ extern "C" {
 	#include <strings.h>
 	#include <signal.h>
 	#include <fcntl.h>
+	#include <pthread.h>
 	ssize_t _read(int, void *, size_t);
+	ssize_t _write(int, const void *, size_t);
 }
 
 static constexpr int LOGGER_PORT = 9021;
 static constexpr int ELF_PORT = 9027;
+static constexpr size_t POOL_SIZE = 2;
+static constexpr int LISTEN_BACKLOG = 16;
+static constexpr uint64_t MAX_ELF_SIZE = 0x10000000;
 
 static constexpr int STDOUT = 1;
 static constexpr int STDERR = 2;
@@ -72,6 +79,10 @@ class FileDescriptor {
 					__builtin_printf("read failed error %s\n", strerror(errno));
 					return false;
 				}
+				if (read == 0) {
+					puts("connection closed before the read completed");
+					return false;
+				}
 				size -= read;
 				buf += read;
 			}
@@ -81,62 +92,259 @@ class FileDescriptor {
 		void release() { fd = -1; }
 };
 
-bool runElf(Hijacker *hijacker, uint16_t port) {
-	socklen_t addr_len;
-	UniquePtr<uint8_t[]> buf = nullptr;
-	{
-		FileDescriptor sock = socket(AF_INET, SOCK_STREAM, 0);
+static int createServer(uint16_t port) {
+	FileDescriptor sock = socket(AF_INET, SOCK_STREAM, 0);
 
-		if (!sock) {
-			__builtin_printf("socket: %s", strerror(errno));
-			return false;
-		}
+	if (!sock) {
+		__builtin_printf("socket: %s", strerror(errno));
+		return -1;
+	}
 
-		int value = 1;
-		if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(int)) < 0) {
-			__builtin_printf("setsockopt: %s", strerror(errno));
-			return false;
+	int value = 1;
+	if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(int)) < 0) {
+		__builtin_printf("setsockopt: %s", strerror(errno));
+		return -1;
+	}
+
+	struct sockaddr_in server_addr{0, AF_INET, htons(port), {}, {}};
+
+	if (bind(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) != 0) {
+		__builtin_printf("bind: %s", strerror(errno));
+		return -1;
+	}
+
+	if (listen(sock, LISTEN_BACKLOG) != 0) {
+		__builtin_printf("listen: %s", strerror(errno));
+		return -1;
+	}
+
+	const int fd = sock;
+	sock.release();
+	return fd;
+}
+
+// sent in place of the size to choose the process the elf is loaded into
+struct LaunchHeader {
+	static constexpr uint64_t MAGIC = 0x31464c4548434e4c; // LNCHELF1
+
+	enum Flags : uint32_t {
+		RESOLVE_ON_HOST = 1, // copy the symbol tables instead of resolving imports in the target
+		VERIFY_IMPORTS = 2, // check the imports resolved in the target against the symbol tables
+		ALL_FLAGS = RESOLVE_ON_HOST | VERIFY_IMPORTS
+	};
+
+	uint64_t magic;
+	int32_t pid; // 0 for a new process
+	uint32_t flags;
+	uint64_t size;
+};
+
+// written back on the connection once the launch has been attempted
+struct LaunchStatus {
+	enum Result : int32_t {
+		OK,
+		QUEUE_FULL,
+		BAD_REQUEST,
+		NO_PROCESS,
+		LAUNCH_FAILED
+	};
+
+	int32_t result;
+	int32_t pid;
+};
+
+struct LaunchRequest {
+	int conn;
+	int pid;
+	uint32_t flags;
+	uint8_t *elf;
+};
+
+// uploads are received concurrently but launched one at a time on the main thread
+class LaunchQueue {
+	static constexpr size_t MAX_PENDING = 16;
+
+	LaunchRequest requests[MAX_PENDING];
+	size_t head;
+	size_t tail;
+	int lock;
+
+	void acquire() {
+		while (__atomic_exchange_n(&lock, 1, __ATOMIC_ACQUIRE)) {
+			__builtin_ia32_pause();
 		}
+	}
 
-		struct sockaddr_in server_addr{0, AF_INET, htons(port), {}, {}};
+	void release() {
+		__atomic_store_n(&lock, 0, __ATOMIC_RELEASE);
+	}
 
-		if (bind(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) != 0) {
-			__builtin_printf("bind: %s", strerror(errno));
-			return false;
+	public:
+		LaunchQueue() : requests(), head(), tail(), lock() {}
+
+		bool push(const LaunchRequest &request) {
+			acquire();
+			const bool full = tail - head == MAX_PENDING;
+			if (!full) {
+				requests[tail++ % MAX_PENDING] = request;
+			}
+			release();
+			return !full;
 		}
 
-		if (listen(sock, 1) != 0) {
-			__builtin_printf("listen: %s", strerror(errno));
-			return false;
+		bool pop(LaunchRequest &request) {
+			acquire();
+			const bool empty = head == tail;
+			if (!empty) {
+				request = requests[head++ % MAX_PENDING];
+			}
+			release();
+			return !empty;
 		}
+};
 
-		struct sockaddr client_addr{};
-		addr_len = sizeof(client_addr);
-		__builtin_printf("waiting for connection to load elf on port %d\n", port);
-		FileDescriptor conn = accept(sock, &client_addr, &addr_len);
-		if (!conn) {
-			__builtin_printf("accept: %s", strerror(errno));
-			return false;
+// launches into the same process share one hijacker so its mailbox, agent and heap are only set up once
+class TargetCache {
+	static constexpr size_t MAX_TARGETS = 8;
+
+	Hijacker *targets[MAX_TARGETS];
+	size_t next;
+
+	public:
+		TargetCache() : targets(), next() {}
+		TargetCache(const TargetCache&) = delete;
+		TargetCache &operator=(const TargetCache&) = delete;
+		~TargetCache() {
+			for (Hijacker *target : targets) {
+				delete target;
+			}
 		}
 
-		__builtin_printf("connection accepted, connfd: %d\n", (int)conn);
+		Hijacker *get(int pid) {
+			for (Hijacker *&target : targets) {
+				if (target == nullptr || target->getPid() != pid) {
+					continue;
+				}
+				if (target->isAlive()) [[likely]] {
+					return target;
+				}
+				// the pid may have been given to another process since
+				delete target;
+				target = nullptr;
+			}
 
-		ssize_t size = 0;
-		if (_read(conn, &size, sizeof(size)) == -1) {
-			__builtin_printf("read size: %s", strerror(errno));
-			return false;
+			UniquePtr<Hijacker> hijacker = Hijacker::getHijacker(pid);
+			if (hijacker == nullptr) {
+				return nullptr;
+			}
+
+			size_t index = 0;
+			while (index < MAX_TARGETS && targets[index] != nullptr) {
+				index++;
+			}
+			if (index == MAX_TARGETS) {
+				// evict the oldest
+				index = next++ % MAX_TARGETS;
+				delete targets[index];
+			}
+			targets[index] = hijacker.release();
+			return targets[index];
 		}
+};
 
-		__builtin_printf("elf size: %lld\n", (long long)size);
+struct Receiver {
+	LaunchQueue *queue;
+	int conn;
+};
 
-		buf = new uint8_t[size];
+static void sendStatus(int conn, LaunchStatus::Result result, int pid) {
+	const LaunchStatus status{result, pid};
+	_write(conn, &status, sizeof(status));
+}
 
-		if (!conn.read(buf.get(), size)) {
-			return false;
+static void *receiveElf(void *ptr) {
+	UniquePtr<Receiver> receiver = static_cast<Receiver *>(ptr);
+	FileDescriptor conn = receiver->conn;
+
+	LaunchHeader header{};
+	if (!conn.read(reinterpret_cast<uint8_t *>(&header.magic), sizeof(header.magic))) {
+		return nullptr;
+	}
+
+	if (header.magic == LaunchHeader::MAGIC) {
+		constexpr size_t remaining = sizeof(header) - sizeof(header.magic);
+		if (!conn.read(reinterpret_cast<uint8_t *>(&header.pid), remaining)) {
+			return nullptr;
 		}
+	} else {
+		// just the size
+		header.size = header.magic;
 	}
 
-	Elf elf{hijacker, buf.release()};
+	__builtin_printf("elf size: %lld\n", (long long)header.size);
+	if (header.size == 0 || header.size > MAX_ELF_SIZE || header.pid < 0 || (header.flags & ~LaunchHeader::ALL_FLAGS) != 0) {
+		puts("rejecting invalid launch request");
+		sendStatus(conn, LaunchStatus::BAD_REQUEST, 0);
+		return nullptr;
+	}
+
+	UniquePtr<uint8_t[]> buf = new uint8_t[header.size];
+
+	if (!conn.read(buf.get(), header.size)) {
+		return nullptr;
+	}
+
+	if (!receiver->queue->push({conn, header.pid, header.flags, buf.get()})) {
+		puts("launch queue is full");
+		sendStatus(conn, LaunchStatus::QUEUE_FULL, 0);
+		return nullptr;
+	}
+
+	// owned by the launcher now
+	buf.release();
+	conn.release();
+	return nullptr;
+}
+
+struct Acceptor {
+	LaunchQueue *queue;
+	int sock;
+};
+
+static void *acceptConnections(void *ptr) {
+	const Acceptor *acceptor = static_cast<Acceptor *>(ptr);
+	while (true) {
+		struct sockaddr client_addr{};
+		socklen_t addr_len = sizeof(client_addr);
+		const int conn = accept(acceptor->sock, &client_addr, &addr_len);
+		if (conn == -1) {
+			if (errno == EBADF || errno == EINVAL) {
+				// main closed the socket
+				break;
+			}
+			__builtin_printf("accept: %s\n", strerror(errno));
+			continue;
+		}
+
+		__builtin_printf("connection accepted, connfd: %d\n", conn);
+
+		pthread_t thread;
+		Receiver *receiver = new Receiver{acceptor->queue, conn};
+		if (pthread_create(&thread, nullptr, receiveElf, receiver) != 0) {
+			puts("failed to create a thread for the connection");
+			delete receiver;
+			close(conn);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+	return nullptr;
+}
+
+bool runElf(Hijacker *hijacker, uint8_t *buf, uint32_t flags) {
+	Elf elf{hijacker, buf};
+	elf.setResolveInTarget((flags & LaunchHeader::RESOLVE_ON_HOST) == 0);
+	elf.setVerifyImports((flags & LaunchHeader::VERIFY_IMPORTS) != 0);
 
 	if (!elf.launch()) {
 		puts("launch failed");
@@ -147,6 +355,38 @@ bool runElf(Hijacker *hijacker, uint16_t port) {
 	return true;
 }
 
+static void launch(ProcessPool &pool, TargetCache &targets, const LaunchRequest &request) {
+	FileDescriptor conn = request.conn;
+	UniquePtr<uint8_t[]> buf = request.elf;
+
+	// a pooled process is only ever launched into once
+	UniquePtr<Hijacker> spawned = request.pid == 0 ? pool.take() : nullptr;
+	Hijacker *target = request.pid != 0 ? targets.get(request.pid) : spawned.get();
+	if (target == nullptr) {
+		if (request.pid != 0) {
+			__builtin_printf("process %d not found\n", request.pid);
+		} else {
+			puts("failed to spawn new redis server process");
+		}
+		sendStatus(conn, LaunchStatus::NO_PROCESS, request.pid);
+		return;
+	}
+
+	const int pid = target->getPid();
+	__builtin_printf("launching into process %s pid %d\n", target->getProc()->getSelfInfo()->name, pid);
+
+	if (runElf(target, buf.release(), request.flags)) {
+		sendStatus(conn, LaunchStatus::OK, pid);
+	} else {
+		if (spawned != nullptr) {
+			// nothing else will ever launch into it
+			ProcessPool::discard(target);
+		}
+		sendStatus(conn, LaunchStatus::LAUNCH_FAILED, pid);
+	}
+	WaitSite::dumpAll();
+}
+
 [[maybe_unused]] static void __attribute__((naked, noinline)) clearFramePointer() {
 	// this clears the frame pointer so we stop the backtrace at the start of our code
 	__asm__ volatile(
@@ -192,10 +432,33 @@ static bool initStdout() {
 }
 
 int main() {
+	// opened first so that the payload can be uploaded while the host process is prepared
+	FileDescriptor sock = createServer(ELF_PORT);
+
 	initStdout();
 	//clearFramePointer();
 	puts("main entered");
 
+	if (!layout::matchesRunningFirmware()) {
+		puts("this payload was built for a different firmware");
+		return -1;
+	}
+
+	if (!sock) {
+		return -1;
+	}
+
+	// static since the thread outlives main if we bail out
+	static LaunchQueue queue{};
+	static Acceptor acceptor{&queue, sock};
+	pthread_t thread;
+	if (pthread_create(&thread, nullptr, acceptConnections, &acceptor) != 0) {
+		puts("failed to start accepting connections");
+		return -1;
+	}
+
+	__builtin_printf("waiting for connection to load elf on port %d\n", ELF_PORT);
+
 	auto processes = dbg::getProcesses();
 	if (processes.length() == 0) {
 		puts("This kernel version is not yet supported :(");
@@ -210,29 +473,21 @@ int main() {
 	puts("jailbreaking original SceRedisServer process");
 	spawner->getHijacker()->jailbreak();
 
-	puts("spawning new SceRedisServer process");
-	auto redis = spawner->spawn();
-
-	if (redis == nullptr) {
-		puts("failed to spawn new redis server process");
+	// the pool spawns and prepares processes in the background while we wait for payloads
+	ProcessPool pool{spawner.get(), "HomebrewDaemon"_sv, POOL_SIZE};
+	if (!pool.start()) {
 		return -1;
 	}
-	puts("getting saved stack pointer");
-	while (redis->getSavedRsp() == 0) {
-		usleep(1);
-	}
-	puts("setting process name");
-	redis->getProc()->setName("HomebrewDaemon"_sv);
-	__builtin_printf("new process %s pid %d\n", redis->getProc()->getSelfInfo()->name, redis->getPid());
-	puts("jailbreaking new process");
-	redis->jailbreak();
-
-	// listen on a port for now. in the future embed the daemon and load directly
 
-	if (runElf(redis.get(), ELF_PORT)) {
-		__builtin_printf("process name %s pid %d\n", redis->getProc()->getSelfInfo()->name, redis->getPid());
-	} else {
-		// TODO kill spawned process on error
+	// launches are done here since every launch needs the kernel and the debugger
+	static constinit WaitSite launchWait{"launch queue"};
+	TargetCache targets{};
+	while (true) {
+		LaunchRequest request;
+		waitUntil(launchWait, [&request]() {
+			return queue.pop(request);
+		}, Deadline::never(), BackoffPolicy::slow());
+		launch(pool, targets, request);
 	}
 
 	return 0;
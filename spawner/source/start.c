@@ -90,6 +90,17 @@ STUB(strncmp)
 STUB(__error)
 STUB(strerror)
 STUB(sceKernelPrintBacktraceWithModuleInfo)
+STUB(shm_open)
+STUB(ftruncate)
+STUB(mmap)
+STUB(munmap)
+STUB(clock_gettime)
+STUB(pthread_create)
+STUB(pthread_join)
+STUB(pthread_detach)
+STUB(sched_yield)
+STUB(open)
+STUB(kill)
 
 #define LINK(lib, fname) sceKernelDlsym(lib, #fname, &f_##fname)
 #define LIBKERNEL_LINK(fname) LINK(libkernel, fname)
@@ -120,6 +131,17 @@ void _start(struct payload_args *args) {
 	LIBKERNEL_LINK(sysctlbyname);
 	LIBKERNEL_LINK(__error);
 	LIBKERNEL_LINK(sceKernelPrintBacktraceWithModuleInfo);
+	LIBKERNEL_LINK(shm_open);
+	LIBKERNEL_LINK(ftruncate);
+	LIBKERNEL_LINK(mmap);
+	LIBKERNEL_LINK(munmap);
+	LIBKERNEL_LINK(clock_gettime);
+	LIBKERNEL_LINK(pthread_create);
+	LIBKERNEL_LINK(pthread_join);
+	LIBKERNEL_LINK(pthread_detach);
+	LIBKERNEL_LINK(sched_yield);
+	LIBKERNEL_LINK(open);
+	LIBKERNEL_LINK(kill);
 
 
 
@@ -0,0 +1,153 @@
+// runs kernel offset discovery against a dump made with dump_kernel.py --allproc
+// this is built for the host, not the ps5, for example
+// clang++ -std=gnu++20 -O2 -mavx2 -I../../include -I$PS5SDK/include -o discover_dump discover_dump.cpp
+// usage: discover_dump kernel_data.bin
+// kernel_data.bin.base and kernel_data.bin.heap are read from next to the image
+// dumping the proc list requires allproc up front, so this only re-checks discovery
+// on firmwares whose allproc is already known, it can't find it for a new one
+
+#include "kernel/discovery.hpp"
+#include "util.hpp"
+
+extern "C" {
+	#include <stdint.h>
+	#include <stdio.h>
+	#include <string.h>
+}
+
+using Region = discovery::DumpReader::Region;
+
+static constexpr uint64_t HEAP_MAGIC = 0x313030504145484b; // KHEAP001
+
+// see dump_kernel.py
+struct HeapFileHeader {
+	uint64_t magic;
+	uint64_t pipeAddr;
+	uint32_t version;
+	int32_t pid;
+};
+
+struct HeapRecord {
+	uint64_t addr;
+	uint64_t length;
+};
+
+static UniquePtr<uint8_t[]> readFile(const char *path, size_t &length) {
+	FILE *fp = fopen(path, "rb");
+	if (fp == nullptr) {
+		return nullptr;
+	}
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	UniquePtr<uint8_t[]> buf{new uint8_t[length]};
+	const size_t n = fread(buf.get(), 1, length, fp);
+	fclose(fp);
+	if (n != length) {
+		return nullptr;
+	}
+	return buf;
+}
+
+static String sidecar(const char *image, const char *suffix) {
+	String path{image};
+	path += StringView{suffix};
+	return path;
+}
+
+// the records are checked and counted first so the regions can be allocated at once
+static Array<Region> parseHeap(const uint8_t *heap, size_t length) {
+	size_t count = 0;
+	for (size_t pos = sizeof(HeapFileHeader); pos < length; count++) {
+		HeapRecord record;
+		if (length - pos < sizeof(record)) {
+			return nullptr;
+		}
+		memcpy(&record, heap + pos, sizeof(record));
+		pos += sizeof(record);
+		if (length - pos < record.length) {
+			return nullptr;
+		}
+		pos += record.length;
+	}
+
+	Array<Region> regions{count};
+	size_t pos = sizeof(HeapFileHeader);
+	for (size_t i = 0; i < count; i++) {
+		HeapRecord record;
+		memcpy(&record, heap + pos, sizeof(record));
+		pos += sizeof(record);
+		regions[i] = {record.addr, heap + pos, record.length};
+		pos += record.length;
+	}
+	return regions;
+}
+
+int main(int argc, const char **argv) {
+	if (argc != 2) {
+		puts("usage: discover_dump kernel_data.bin");
+		puts("the image must be dumped with dump_kernel.py --allproc so only firmwares with a known allproc can be checked");
+		return 2;
+	}
+	const char *image = argv[1];
+
+	size_t size = 0;
+	UniquePtr<uint8_t[]> data = readFile(image, size);
+	if (data == nullptr) {
+		printf("failed to read %s\n", image);
+		return 2;
+	}
+
+	size_t baseLength = 0;
+	UniquePtr<uint8_t[]> baseText = readFile(sidecar(image, ".base").c_str(), baseLength);
+	if (baseText == nullptr) {
+		printf("failed to read %s.base\n", image);
+		return 2;
+	}
+	String text{StringView{(const char *)baseText.get(), baseLength}};
+	const uintptr_t base = strtoull(text.c_str(), nullptr, 16);
+
+	size_t heapLength = 0;
+	UniquePtr<uint8_t[]> heap = readFile(sidecar(image, ".heap").c_str(), heapLength);
+	HeapFileHeader header;
+	if (heap == nullptr || heapLength < sizeof(header)) {
+		// without the proc list allproc can't be told apart from any other list head
+		printf("failed to read %s.heap, dump again with --allproc\n", image);
+		return 2;
+	}
+	memcpy(&header, heap.get(), sizeof(header));
+	if (header.magic != HEAP_MAGIC) {
+		printf("bad magic in %s.heap\n", image);
+		return 2;
+	}
+	if (heapLength == sizeof(header)) {
+		// dump_kernel.py couldn't read the first proc, the --allproc offset is likely wrong
+		printf("%s.heap has no regions\n", image);
+		return 2;
+	}
+	Array<Region> regions = parseHeap(heap.get(), heapLength);
+	if (!regions) {
+		printf("%s.heap is truncated\n", image);
+		return 2;
+	}
+
+	printf("kernel_base: 0x%llx version: 0x%x pid: %d heap regions: %llu\n",
+		(unsigned long long) base, header.version, header.pid, (unsigned long long) regions.length());
+
+	const discovery::DumpReader reader{base, data.get(), size, regions.data(), regions.length()};
+	layout::KernelLayout result{};
+	if (!discovery::discover(reader, header.version, header.pipeAddr, header.pid, result)) {
+		puts("failed to find the kernel offsets");
+		return 1;
+	}
+	printf("allproc: 0x%llx root_vnode: 0x%llx\n",
+		(unsigned long long) result.allproc, (unsigned long long) result.root_vnode);
+
+	const layout::KernelLayout *known = layout::find(header.version);
+	if (known != nullptr && (known->allproc != result.allproc || known->root_vnode != result.root_vnode)) {
+		printf("differs from layout::LAYOUTS allproc: 0x%llx root_vnode: 0x%llx\n",
+			(unsigned long long) known->allproc, (unsigned long long) known->root_vnode);
+		return 1;
+	}
+	return 0;
+}
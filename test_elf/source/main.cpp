@@ -1,26 +1,77 @@
-
 extern "C" {
 	#include <ps5/payload_main.h>
 	#include <arpa/inet.h>
 	#include <netinet/in.h>
 	#include <sys/socket.h>
+	#include <pthread.h>
 	#include <string.h>
 	#include <stdio.h>
 	#include <unistd.h>
+	#include <sys/types.h>
+	#include <sys/sysctl.h>
+	ssize_t _read(int, void *, size_t);
 	ssize_t _write(int, const void *, size_t);
 	void kernel_copyin(const void *src, uint64_t kdest, size_t length);
 	void kernel_copyout(uint64_t ksrc, void *dest, size_t length);
 	extern uintptr_t kernel_base;
+	extern uint64_t _pipe_addr;
 }
 
-class Buffer {
-	uint8_t *buf;
+// see dump_kernel.py for the other end
 
-	public:
-		explicit Buffer() : buf(new uint8_t[BUFSIZ]) {}
-		~Buffer() { delete[] buf; }
-		constexpr size_t length() const { return BUFSIZ; }
-		operator void*() const { return buf; }
+static constexpr size_t KERNEL_DATA_SIZE = 0x87BF000;
+static constexpr size_t PAGE_SIZE = 0x1000;
+static constexpr size_t PAGES_PER_CHUNK = 0x100;
+static constexpr size_t CHUNK_SIZE = PAGE_SIZE * PAGES_PER_CHUNK;
+static constexpr size_t NUM_SLOTS = 4;
+
+// the part of the direct map the r/w pipe was allocated from, anything else may panic the kernel
+static constexpr unsigned int DMAP_SHIFT = 39;
+static constexpr uintptr_t MAX_PHYSICAL = 0x800000000;
+
+struct DumpHeader {
+	static constexpr uint64_t MAGIC = 0x313030504d55444b; // KDUMP001
+
+	uint64_t magic;
+	uint64_t base;
+	uint64_t size;
+	uint32_t pageSize;
+	uint32_t flags;
+};
+
+enum DumpFlags : uint32_t {
+	DUMP_LZ4 = 1,
+	DUMP_HEAP = 2 // serve page requests after the data segment
+};
+
+// sent after the data segment when DUMP_HEAP is set, what discovery needs besides memory
+struct HeapHeader {
+	uint64_t pipeAddr;
+	uint32_t version;
+	int32_t pid;
+};
+
+// answered with a chunk which has no pages if the range is refused
+// a request with no pages ends the dump
+struct PageRequest {
+	uint64_t addr;
+	uint32_t pages;
+	uint32_t reserved;
+};
+
+// followed by one PageType per page and then the data of the pages which were not elided
+// a chunk with no pages ends the dump
+struct ChunkHeader {
+	uint64_t offset;
+	uint32_t pages;
+	uint32_t length;
+};
+
+enum PageType : uint8_t {
+	PAGE_ZERO,
+	PAGE_REPEAT, // same as the page before it
+	PAGE_RAW,
+	PAGE_LZ4 // a uint32_t length and then the compressed page
 };
 
 class Socket {
@@ -55,8 +106,29 @@ class Socket {
 		}
 		int getFd() const { return fd; }
 		explicit operator bool() const { return fd != -1; }
-		void write(const Buffer &buf) const {
-			_write(fd, buf, buf.length());
+		bool write(const void *buf, size_t length) const {
+			const uint8_t *ptr = static_cast<const uint8_t *>(buf);
+			while (length > 0) {
+				const ssize_t n = _write(fd, ptr, length);
+				if (n <= 0) {
+					return false;
+				}
+				ptr += n;
+				length -= n;
+			}
+			return true;
+		}
+		bool read(void *buf, size_t length) const {
+			uint8_t *ptr = static_cast<uint8_t *>(buf);
+			while (length > 0) {
+				const ssize_t n = _read(fd, ptr, length);
+				if (n <= 0) {
+					return false;
+				}
+				ptr += n;
+				length -= n;
+			}
+			return true;
 		}
 };
 
@@ -90,16 +162,327 @@ Socket connect() {
 	return fd;
 }
 
-constexpr size_t KERNEL_DATA_SIZE = 0x87BF000;
+// a minimal lz4 block compressor, good enough for the few pages which aren't elided
+class Lz4 {
+	static constexpr unsigned int HASH_BITS = 12;
+	static constexpr uint32_t EMPTY = 0xffffffff;
+	static constexpr size_t MIN_MATCH = 4;
+	static constexpr size_t LAST_LITERALS = 5;
+	static constexpr size_t MATCH_LIMIT = 12;
+	static constexpr size_t MAX_OFFSET = 0xffff;
+
+	uint32_t table[1 << HASH_BITS];
+
+	static uint32_t read32(const uint8_t *p) {
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static uint32_t hash(uint32_t v) {
+		return (v * 2654435761U) >> (32 - HASH_BITS);
+	}
+
+	static bool writeLength(uint8_t *&op, const uint8_t *end, size_t length) {
+		while (length >= 0xff) {
+			if (op == end) {
+				return false;
+			}
+			*op++ = 0xff;
+			length -= 0xff;
+		}
+		if (op == end) {
+			return false;
+		}
+		*op++ = (uint8_t) length;
+		return true;
+	}
+
+	static bool writeSequence(uint8_t *&op, const uint8_t *end, const uint8_t *literals, size_t numLiterals, size_t offset, size_t matchLength) {
+		if (op == end) {
+			return false;
+		}
+		uint8_t *token = op++;
+		*token = (uint8_t) ((numLiterals < 0xf ? numLiterals : 0xf) << 4);
+		if (numLiterals >= 0xf && !writeLength(op, end, numLiterals - 0xf)) {
+			return false;
+		}
+		if ((size_t) (end - op) < numLiterals) {
+			return false;
+		}
+		memcpy(op, literals, numLiterals);
+		op += numLiterals;
+		if (matchLength == 0) {
+			// the last sequence has no match
+			return true;
+		}
+		if (end - op < 2) {
+			return false;
+		}
+		*op++ = (uint8_t) offset;
+		*op++ = (uint8_t) (offset >> 8);
+		matchLength -= MIN_MATCH;
+		*token |= matchLength < 0xf ? matchLength : 0xf;
+		return matchLength < 0xf || writeLength(op, end, matchLength - 0xf);
+	}
+
+	public:
+		/**
+		 * Compresses a block
+		 * @param src the data to compress
+		 * @param length the length of the data
+		 * @param dst the output
+		 * @param capacity the size of the output
+		 * @return the compressed length or 0 if it would not fit
+		 */
+		size_t compress(const uint8_t *src, size_t length, uint8_t *dst, size_t capacity) {
+			memset(table, 0xff, sizeof(table));
+			uint8_t *op = dst;
+			const uint8_t *end = dst + capacity;
+			size_t anchor = 0;
+			size_t ip = 0;
+			const size_t limit = length > MATCH_LIMIT ? length - MATCH_LIMIT : 0;
+			while (ip < limit) {
+				const uint32_t seq = read32(src + ip);
+				const uint32_t h = hash(seq);
+				const uint32_t ref = table[h];
+				table[h] = ip;
+				if (ref == EMPTY || ip - ref > MAX_OFFSET || read32(src + ref) != seq) {
+					ip++;
+					continue;
+				}
+				size_t matchLength = MIN_MATCH;
+				while (ip + matchLength < length - LAST_LITERALS && src[ref + matchLength] == src[ip + matchLength]) {
+					matchLength++;
+				}
+				if (!writeSequence(op, end, src + anchor, ip - anchor, ip - ref, matchLength)) {
+					return 0;
+				}
+				ip += matchLength;
+				anchor = ip;
+			}
+			if (!writeSequence(op, end, src + anchor, length - anchor, 0, 0)) {
+				return 0;
+			}
+			return op - dst;
+		}
+};
+
+struct Slot {
+	ChunkHeader header;
+	uint8_t data[CHUNK_SIZE];
+	// the page map followed by the pages
+	uint8_t out[PAGES_PER_CHUNK + PAGES_PER_CHUNK * (sizeof(uint32_t) + PAGE_SIZE)];
+};
+
+// the reader fills slots and the sender drains them in order
+class Ring {
+	Slot slots[NUM_SLOTS];
+	size_t produced;
+	size_t consumed;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	public:
+		Ring() : slots(), produced(), consumed() {
+			pthread_mutex_init(&lock, nullptr);
+			pthread_cond_init(&cond, nullptr);
+		}
+
+		~Ring() {
+			pthread_cond_destroy(&cond);
+			pthread_mutex_destroy(&lock);
+		}
+
+		Slot &acquireFree() {
+			pthread_mutex_lock(&lock);
+			while (produced - consumed == NUM_SLOTS) {
+				pthread_cond_wait(&cond, &lock);
+			}
+			Slot &slot = slots[produced % NUM_SLOTS];
+			pthread_mutex_unlock(&lock);
+			return slot;
+		}
+
+		void publish() {
+			pthread_mutex_lock(&lock);
+			produced++;
+			pthread_cond_broadcast(&cond);
+			pthread_mutex_unlock(&lock);
+		}
+
+		Slot &acquireFilled() {
+			pthread_mutex_lock(&lock);
+			while (produced == consumed) {
+				pthread_cond_wait(&cond, &lock);
+			}
+			Slot &slot = slots[consumed % NUM_SLOTS];
+			pthread_mutex_unlock(&lock);
+			return slot;
+		}
+
+		void release() {
+			pthread_mutex_lock(&lock);
+			consumed++;
+			pthread_cond_broadcast(&cond);
+			pthread_mutex_unlock(&lock);
+		}
+};
+
+struct Dumper {
+	Ring ring;
+	Lz4 lz4;
+	uint32_t flags;
+	volatile bool stop;
+	uint8_t previous[PAGE_SIZE];
+	bool havePrevious;
+};
+
+static bool isZero(const uint8_t *page) {
+	const uint64_t *words = reinterpret_cast<const uint64_t *>(page);
+	uint64_t bits = 0;
+	for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+		bits |= words[i];
+	}
+	return bits == 0;
+}
+
+// classifies and packs the pages of a chunk, returns the length of slot.out
+static size_t pack(Dumper &dumper, Slot &slot, size_t pages) {
+	uint8_t *map = slot.out;
+	uint8_t *op = slot.out + pages;
+	for (size_t i = 0; i < pages; i++) {
+		const uint8_t *page = slot.data + i * PAGE_SIZE;
+		const uint8_t *last = i != 0 ? page - PAGE_SIZE : (dumper.havePrevious ? dumper.previous : nullptr);
+		if (isZero(page)) {
+			map[i] = PAGE_ZERO;
+		} else if (last != nullptr && memcmp(page, last, PAGE_SIZE) == 0) {
+			map[i] = PAGE_REPEAT;
+		} else {
+			size_t compressed = 0;
+			if (dumper.flags & DUMP_LZ4) {
+				// only worth it if it saves something
+				compressed = dumper.lz4.compress(page, PAGE_SIZE, op + sizeof(uint32_t), PAGE_SIZE - sizeof(uint32_t) - 1);
+			}
+			if (compressed != 0) {
+				const uint32_t length = compressed;
+				memcpy(op, &length, sizeof(length));
+				op += sizeof(length) + compressed;
+				map[i] = PAGE_LZ4;
+			} else {
+				memcpy(op, page, PAGE_SIZE);
+				op += PAGE_SIZE;
+				map[i] = PAGE_RAW;
+			}
+		}
+	}
+	memcpy(dumper.previous, slot.data + (pages - 1) * PAGE_SIZE, PAGE_SIZE);
+	dumper.havePrevious = true;
+	return op - slot.out;
+}
+
+static void *readKernel(void *ptr) {
+	Dumper &dumper = *static_cast<Dumper *>(ptr);
+	for (size_t offset = 0; offset < KERNEL_DATA_SIZE && !dumper.stop; offset += CHUNK_SIZE) {
+		Slot &slot = dumper.ring.acquireFree();
+		const size_t length = KERNEL_DATA_SIZE - offset < CHUNK_SIZE ? KERNEL_DATA_SIZE - offset : CHUNK_SIZE;
+		const size_t pages = length / PAGE_SIZE;
+		kernel_copyout(kernel_base + offset, slot.data, length);
+		slot.header = {offset, (uint32_t) pages, (uint32_t) pack(dumper, slot, pages)};
+		dumper.ring.publish();
+	}
+	Slot &slot = dumper.ring.acquireFree();
+	slot.header = {KERNEL_DATA_SIZE, 0, 0};
+	dumper.ring.publish();
+	return nullptr;
+}
+
+static uint32_t getSystemSwVersion() {
+	uint32_t version = 0;
+	size_t size = sizeof(version);
+	sysctlbyname("kern.sdk_version", &version, &size, nullptr, 0);
+	return version;
+}
+
+// the client walks the proc list in its copy of the data segment and asks for each page it needs
+static bool servePages(const Socket &sock, Dumper &dumper) {
+	const HeapHeader header{_pipe_addr, getSystemSwVersion(), getpid()};
+	if (!sock.write(&header, sizeof(header))) {
+		return false;
+	}
+
+	const uintptr_t dmap = (_pipe_addr >> DMAP_SHIFT) << DMAP_SHIFT;
+	// the reader is done with the ring so any slot will do
+	Slot &slot = dumper.ring.acquireFree();
+	PageRequest request{};
+	while (sock.read(&request, sizeof(request)) && request.pages != 0) {
+		const size_t length = request.pages * PAGE_SIZE;
+		const bool allowed = request.pages <= PAGES_PER_CHUNK && (request.addr & (PAGE_SIZE - 1)) == 0
+			&& request.addr >= dmap && request.addr + length <= dmap + MAX_PHYSICAL;
+		if (!allowed) {
+			const ChunkHeader refused{request.addr, 0, 0};
+			if (!sock.write(&refused, sizeof(refused))) {
+				return false;
+			}
+			continue;
+		}
+		kernel_copyout(request.addr, slot.data, length);
+		// requests are unrelated so a page may not repeat the previous one
+		dumper.havePrevious = false;
+		slot.header = {request.addr, request.pages, (uint32_t) pack(dumper, slot, request.pages)};
+		if (!sock.write(&slot.header, sizeof(slot.header)) || !sock.write(slot.out, slot.header.length)) {
+			return false;
+		}
+	}
+	return true;
+}
 
 int main() {
-	Buffer buf{};
 	Socket sock = connect();
-	dup2(sock.getFd(), 1);
-	dup2(sock.getFd(), 2);
-	for (size_t i = 0; i < KERNEL_DATA_SIZE; i += buf.length()) {
-		kernel_copyout(kernel_base + i, buf, buf.length());
-		sock.write(buf);
+	if (!sock) {
+		return -1;
+	}
+
+	uint32_t flags = 0;
+	if (!sock.read(&flags, sizeof(flags))) {
+		return -1;
+	}
+
+	// too big for the stack
+	Dumper *dumper = new Dumper{};
+	dumper->flags = flags;
+
+	const DumpHeader header{DumpHeader::MAGIC, kernel_base, KERNEL_DATA_SIZE, PAGE_SIZE, flags};
+	if (!sock.write(&header, sizeof(header))) {
+		delete dumper;
+		return -1;
+	}
+
+	pthread_t reader;
+	if (pthread_create(&reader, nullptr, readKernel, dumper) != 0) {
+		delete dumper;
+		return -1;
+	}
+
+	while (true) {
+		Slot &slot = dumper->ring.acquireFilled();
+		const ChunkHeader chunk = slot.header;
+		bool ok = sock.write(&chunk, sizeof(chunk));
+		ok = ok && sock.write(slot.out, chunk.length);
+		dumper->ring.release();
+		if (chunk.pages == 0) {
+			break;
+		}
+		if (!ok) {
+			// let the reader run to the end so it can be joined
+			dumper->stop = true;
+		}
+	}
+
+	pthread_join(reader, nullptr);
+	if ((flags & DUMP_HEAP) && !dumper->stop) {
+		servePages(sock, *dumper);
 	}
+	delete dumper;
 	return 0;
 }